@@ -34,7 +34,7 @@ public:
     Animation(Skeleton* _skeleton, std::string amcpath);
 
     // Load animation from a vector of frames
-    Animation(Skeleton* _skeleton, std::vector<Frame> frames);
+    Animation(Skeleton* _skeleton, std::vector<Frame> frames, const int _id = -1);
 
     // Compute the local transforms for a frame
     void calculateFrame(int frame_num);
@@ -46,6 +46,10 @@ public:
     // Compute the vertices for a frame
     std::vector<float> getVertices(glm::vec3* ltoe = NULL, glm::vec3* rtoe = NULL);
 
+    // Compute the vertices for a frame with a given normalisation without writing to the skeleton
+    // Unlike calculateFrame & getVertices, this is safe to call from multiple threads
+    std::vector<float> getVerticesWithNormalisation(int frame_num, glm::mat4 starting_pos, glm::quat starting_rot) const;
+
     // Normalise / unNormalise transforms
     static void normaliseTransform(glm::mat4& current_pos, glm::quat& current_rot, glm::mat4 starting_pos, glm::quat starting_rot);
     static void unNormaliseTransform(glm::mat4& current_pos, glm::quat& current_rot, glm::mat4 starting_pos, glm::quat starting_rot);
@@ -61,6 +65,7 @@ public:
     int getID() const;
     int getFrameSize() const;
     Frame getFrame(int indexID) const;
+    const std::map<std::string, glm::quat>& getFramePose(int indexID) const;     // joint rotations without a copy
     glm::mat4 getFramePos(int indexID) const;
     glm::quat getFrameRot(int indexID) const;
 
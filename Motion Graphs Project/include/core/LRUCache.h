@@ -0,0 +1,88 @@
+#pragma once
+
+#include <list>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <functional>
+
+// Bounded in-memory cache that evicts the least recently used entry once it holds more than capacity entries
+// get & put are thread safe
+template <typename Key, typename Value, typename Compare = std::less<Key>>
+class LRUCache
+{
+public:
+	LRUCache(const size_t _capacity) {
+		capacity = _capacity;
+	}
+
+	// Copy the cached value to value. Returns false on a miss
+	bool get(const Key& key, Value& value) {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto it = index.find(key);
+		if (it == index.end()) {
+			misses++;
+			return false;
+		}
+
+		// mark as most recently used
+		entries.splice(entries.begin(), entries, it->second);
+		value = it->second->second;
+		hits++;
+		return true;
+	}
+
+	void put(const Key& key, const Value& value) {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto it = index.find(key);
+		if (it != index.end()) {
+			it->second->second = value;
+			entries.splice(entries.begin(), entries, it->second);
+			return;
+		}
+
+		entries.emplace_front(key, value);
+		index[key] = entries.begin();
+
+		// evict the least recently used entry
+		if (entries.size() > capacity) {
+			index.erase(entries.back().first);
+			entries.pop_back();
+		}
+	}
+
+	void clear() {
+		std::lock_guard<std::mutex> lock(mutex);
+		entries.clear();
+		index.clear();
+	}
+
+	size_t size() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return entries.size();
+	}
+
+	size_t getCapacity() const {
+		return capacity;
+	}
+
+	long long getHits() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return hits;
+	}
+
+	long long getMisses() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return misses;
+	}
+
+private:
+	size_t capacity;
+	std::list<std::pair<Key, Value>> entries;		// most recently used first
+	std::map<Key, typename std::list<std::pair<Key, Value>>::iterator, Compare> index;
+	std::mutex mutex;
+	long long hits = 0;
+	long long misses = 0;
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cassert>
+#include <exception>
+
+// Dependency driven task scheduler
+// Tasks are grouped into stages and become ready once all of their dependencies are done. Ready tasks of later stages
+// run first, so work flows through the stages as soon as possible and the stages overlap instead of running in phases
+class Scheduler
+{
+public:
+	// n_threads = -1 uses all hardware threads
+	Scheduler(const int _n_threads = -1);
+
+	// Add a task to a stage. Stages are ordered by the first time they are used
+	// dependencies are task ids returned by addTask, negative ids are ignored
+	int addTask(const std::string stage, std::function<void()> function, const std::vector<int>& dependencies = {});
+
+	// Run all tasks and block until they are done
+	// If a task throws, no other task is started and the first exception is rethrown once the running tasks are done
+	void run();
+
+	// Print the per-stage queue depth & utilisation of the last run
+	void printMetrics();
+
+	int getThreadCount();
+
+private:
+	struct Task {
+		int stage;
+		std::function<void()> function;
+		int n_dependencies = 0;			// number of unfinished dependencies
+		std::vector<int> dependents;	// tasks waiting on this task
+	};
+
+	struct Stage {
+		std::string name;
+		int n_tasks = 0;
+		int queued = 0;					// ready tasks waiting for a thread
+		int maxQueued = 0;				// maximum queue depth
+		double sumQueued = 0.0;			// queue depth sampled whenever a task of the stage starts
+		double busy = 0.0;				// seconds spent running tasks of the stage
+		double firstStart = -1.0;		// seconds since the start of the run
+		double lastEnd = 0.0;
+	};
+
+	int n_threads;
+	std::vector<Task> tasks;
+	std::vector<Stage> stages;
+	double wall = 0.0;
+
+	// ready tasks ordered by (stage, -task id): later stages first, then in order of insertion
+	std::priority_queue<std::pair<int, int>> ready;
+	int n_remaining = 0;
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::exception_ptr exception;		// first exception thrown by a task of the run
+	std::chrono::steady_clock::time_point start;
+
+	void push(int taskID);
+	void worker();
+	double elapsed();
+};
@@ -12,6 +12,7 @@
 
 #include <iostream>
 #include <fstream> 
+#include <sstream>
 #include <vector>
 #include <stack>
 #include <map>
@@ -26,6 +27,9 @@ public:
     // Constructor
 	Skeleton(std::string filepath);
 
+    // Constructor from the contents of an asf file
+    Skeleton(std::istream& stream);
+
     // Returns the bone via given a bonename
     Bone* getBoneByName(std::string bone_name) const;
 
@@ -38,9 +42,14 @@ public:
     // Get the bonename by index in bonepile
     std::string getBonenameByIndex(int index) const;
 
+    // Get the contents of the asf file
+    const std::string& getSource() const;
+
 private:
     std::map<std::string, Bone*> bonepile;
     std::vector<std::string> bonenames;
+    std::string source;
+    void parse(const std::string asf);
     static Bone::BoneStruct clearBoneStruct();
 };
 
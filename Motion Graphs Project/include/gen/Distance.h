@@ -37,14 +37,30 @@ public:
 		}
 	};
 
+	// version of the distance algorithm, bump this whenever the metric changes to invalidate cached matrices
+	static const int VERSION = 1;
+
 	Animation* A1;
 	Animation* A2;
 	int SIZE;
 
+	// point cloud of a window of frames, normalised to the first frame of the window
+	struct PointCloud {
+		std::vector<float> x;
+		std::vector<float> y;
+		std::vector<float> z;
+	};
+
 	Distance(Animation* _A1, Animation* _A2, int _SIZE);
 	std::vector<std::vector<float>> distance(const int STEP_SIZE = 1);
 
+	// The point clouds of every window of an animation only depend on that animation, so they can be computed once per animation
+	// and shared between all pairs. Both functions are thread safe
+	static std::vector<PointCloud> pointClouds(const Animation* A, const int SIZE, const int STEP_SIZE = 1);
+	static std::vector<std::vector<float>> distance(const std::vector<PointCloud>& clouds1, const std::vector<PointCloud>& clouds2);
+
 private:
+	static float distanceOfClouds(const PointCloud& cloud1, const PointCloud& cloud2);
 	float distanceOfClip(Clip C1, Clip C2);
 	void genPointCloud(Animation* A, int frame_id, std::map<char, std::vector<float>>* result, std::vector<float>* weights, glm::mat4 norm_pos, glm::quat norm_rot);
 	void printCSV(std::map<char, std::vector<float>> cloud);
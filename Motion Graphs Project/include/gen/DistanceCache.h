@@ -0,0 +1,53 @@
+#pragma once
+
+#include <gen/Distance.h>
+#include <gen/FileIndex.h>
+
+#include <vector>
+#include <map>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <limits>
+#include <filesystem>
+#include <cstdint>
+
+// content-addressed cache of distance matrices
+// entries are keyed by the hashes of both amc files, the asf file, the distance algorithm version and all parameters,
+// so a single cache directory can be shared across subjects and machines without returning stale matrices
+// the cache directory can be shared by several processes, see FileIndex
+// load, store & contains are thread safe
+class DistanceCache
+{
+public:
+	static const long long DEFAULT_QUOTA = 1024LL * 1024 * 1024;	// 1GB
+
+	DistanceCache(const std::string _cachedir, const long long _quota = DEFAULT_QUOTA);
+
+	// Hash the contents of a file
+	static std::string hashFile(const std::string filepath);
+
+	// Hash a string
+	static std::string hashString(const std::string data);
+
+	// Generate the key of a distance matrix
+	static std::string makeKey(const std::string amc_hash1, const std::string amc_hash2, const std::string asf_hash, const int WINDOW_SIZE, const int STEP_SIZE);
+
+	// Check if a distance matrix is cached
+	bool contains(const std::string key);
+
+	// Load / store a distance matrix. load returns false on a miss, including an entry that was evicted or is unreadable
+	bool load(const std::string key, std::vector<std::vector<float>>& distance);
+	void store(const std::string key, const std::vector<std::vector<float>>& distance);
+
+private:
+	FileIndex index;	// the .dist files & their last used times
+
+	static std::uint64_t fnv1a(const char* data, size_t size, std::uint64_t hash = 14695981039346656037ULL);
+	static std::string toHex(std::uint64_t hash);
+
+	static void saveDistanceToFile(const std::vector<std::vector<float>>& distance, std::string filename);
+	static bool loadDistanceFromFile(std::string filename, long long size, std::vector<std::vector<float>>& distance);
+};
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <algorithm>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <filesystem>
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <ctime>
+#include <mutex>
+
+// index of the entries of a cache directory, one file [KEY][EXTENSION] per entry, kept in [cachedir]index.txt
+// with the size & last used time of each. Entries are evicted least recently used first to keep the directory under quota
+// several processes can share a directory: index.txt is only changed under a lock file, merged with the index on disk,
+// so a process never drops the entries of another or leaves files that are not in the index
+// all members are thread safe
+class FileIndex
+{
+public:
+	FileIndex(const std::string _cachedir, const std::string _extension, const long long _quota);
+	~FileIndex();	// writes the last used times of the hits since the last add
+
+	std::string entryPath(const std::string key) const;
+
+	// Check if an entry is indexed
+	bool contains(const std::string key);
+
+	// Mark an entry as used & get the size of its file. Returns false if it is not indexed
+	// the last used time is written with the next add or when the index is closed
+	bool touch(const std::string key, long long& size);
+
+	// Drop an entry whose file could not be read, if the file is gone
+	void missing(const std::string key);
+
+	// Move a written file into place as the entry key & evict to keep the directory under quota
+	// Returns false if the file could not be moved, the entry is then not cached
+	bool add(const std::string key, const std::string temp_path);
+
+private:
+	struct Entry {
+		long long size = 0;			// size of the file in bytes
+		long long lastUsed = 0;		// time of last access, used for LRU eviction
+	};
+
+	static constexpr std::chrono::seconds LOCK_TIMEOUT{ 30 };	// a lock held longer is left by a process that died
+
+	std::string cachedir;
+	std::string extension;
+	long long quota;
+	std::map<std::string, Entry> index;			// index.txt as of the last sync, with the changes since
+	std::map<std::string, long long> touched;	// last used times since the last sync
+	std::set<std::string> dropped;				// entries dropped since the last sync
+	std::mutex mutex;	// guards the members & index.txt within the process, the lock file between processes
+	bool locked = false;	// the lock file is held
+
+	std::string indexPath() const;
+	std::string lockPath() const;
+	void lockFile();
+	void unlockFile();
+
+	std::map<std::string, Entry> loadIndex();
+	void saveIndex();
+	void adoptOrphans();
+	void sync();
+	void evict(const std::string keep);
+};
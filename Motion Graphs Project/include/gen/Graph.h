@@ -5,6 +5,9 @@
 
 #include <core/Animation.h>
 #include <core/Skeleton.h>
+#include <core/LRUCache.h>
+#include <core/Scheduler.h>
+#include <gen/SCC.h>
 
 #include <vector>
 #include <map>
@@ -12,125 +15,331 @@
 #include <stack>
 #include <algorithm>
 #include <fstream>
+#include <sstream>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <filesystem>
+#include <span>
+#include <memory>
+#include <cassert>
+#include <cmath>
+#include <functional>
+#include <numeric>
 
 class Graph
 {
 
 public:
 
+	// bit widths of the FrameID fields, packed into 64 bits
+	static const int ANIM_BITS = 8;
+	static const int INDEX_BITS = 19;
+	static const int ALPHA_BITS = 9;
+
+	// largest values a FrameID can hold
+	static const int MAX_ANIM_ID = (1 << (ANIM_BITS - 1)) - 1;
+	static const int MAX_INDEX_ID = (1 << (INDEX_BITS - 1)) - 1;
+	static const int MAX_ALPHA = (1 << (ALPHA_BITS - 1)) - 1;
+
+	// key of a frame, the fields are signed bitfields packed into a single 64 bit word
+	// (64 bit field types so MSVC keeps them in one allocation unit as well)
+	// ordering & equality compare the packed word without branching
 	struct FrameID {
-		int animID = -1;		//	animationID
-		int indexID = -1;		//	indexID
-		int animID2 = -1;		//	2nd animation ID (for transitions)
-		int indexID2 = -1;		//	2nd index ID (for transtions)
-		int alpha = -1;			//	alpha value of the interpolation
-		bool tMode = false;		//	flag to identify if it is a transition
+		std::int64_t animID : ANIM_BITS = -1;			//	animationID
+		std::int64_t indexID : INDEX_BITS = -1;		//	indexID
+		std::int64_t animID2 : ANIM_BITS = -1;			//	2nd animation ID (for transitions)
+		std::int64_t indexID2 : INDEX_BITS = -1;		//	2nd index ID (for transtions)
+		std::int64_t alpha : ALPHA_BITS = -1;			//	alpha value of the interpolation
+		std::uint64_t tMode : 1 = false;		//	flag to identify if it is a transition
+
+		// order preserving key: tMode | animID | indexID | animID2 | indexID2 | alpha, most significant first
+		// flipping the sign bit of each field maps it to an unsigned value in the same order
+		constexpr std::uint64_t pack() const {
+			return (std::uint64_t(tMode) << (2 * ANIM_BITS + 2 * INDEX_BITS + ALPHA_BITS))
+				| (field(animID, ANIM_BITS) << (ANIM_BITS + 2 * INDEX_BITS + ALPHA_BITS))
+				| (field(indexID, INDEX_BITS) << (ANIM_BITS + INDEX_BITS + ALPHA_BITS))
+				| (field(animID2, ANIM_BITS) << (INDEX_BITS + ALPHA_BITS))
+				| (field(indexID2, INDEX_BITS) << ALPHA_BITS)
+				| field(alpha, ALPHA_BITS);
+		}
+
+		static constexpr FrameID unpack(const std::uint64_t key) {
+			FrameID frameID;
+			frameID.tMode = (key >> (2 * ANIM_BITS + 2 * INDEX_BITS + ALPHA_BITS)) & 1;
+			frameID.animID = unfield(key >> (ANIM_BITS + 2 * INDEX_BITS + ALPHA_BITS), ANIM_BITS);
+			frameID.indexID = unfield(key >> (ANIM_BITS + INDEX_BITS + ALPHA_BITS), INDEX_BITS);
+			frameID.animID2 = unfield(key >> (INDEX_BITS + ALPHA_BITS), ANIM_BITS);
+			frameID.indexID2 = unfield(key >> ALPHA_BITS, INDEX_BITS);
+			frameID.alpha = unfield(key, ALPHA_BITS);
+			return frameID;
+		}
 
 		// comparison operator
-		bool operator<(const FrameID& other) const {
-			if (tMode != other.tMode) {
-				return tMode < other.tMode;
-			}
-			else if (animID != other.animID) {
-				return animID < other.animID;
-			}
-			else if (indexID != other.indexID) {
-				return indexID < other.indexID;
-			}
-			else if (animID2 != other.animID2) {
-				return animID2 < other.animID2;
-			}
-			else if (indexID2 != other.indexID2) {
-				return indexID2 < other.indexID2;
-			}
-			else {
-				return alpha < other.alpha;
-			}
+		constexpr bool operator<(const FrameID& other) const {
+			return pack() < other.pack();
 		}
 
 		// equals operator
-		bool const operator==(const FrameID& frameID) const {
-			bool equals = true;
-			equals = equals && (animID == frameID.animID);
-			equals = equals && (indexID == frameID.indexID);
-			equals = equals && (animID2 == frameID.animID2);
-			equals = equals && (indexID2 == frameID.indexID2);
-			equals = equals && (tMode == frameID.tMode);
-			equals = equals && (alpha == frameID.alpha);
-
-			return equals;
+		constexpr bool operator==(const FrameID& frameID) const {
+			return pack() == frameID.pack();
 		}
 
 		// not equals operator
-		bool const operator!=(const FrameID& frameID) const {
-			return !operator==(frameID);
+		constexpr bool operator!=(const FrameID& frameID) const {
+			return pack() != frameID.pack();
+		}
+
+	private:
+		static constexpr std::uint64_t field(const int value, const int bits) {
+			return (std::uint64_t(value) ^ (std::uint64_t(1) << (bits - 1))) & ((std::uint64_t(1) << bits) - 1);
+		}
+
+		static constexpr int unfield(const std::uint64_t key, const int bits) {
+			return int(key & ((std::uint64_t(1) << bits) - 1)) - (1 << (bits - 1));
 		}
 	};
 
+	// undirected transition between two frames (animID, indexID) with its distance, from the local minima
+	typedef std::tuple<std::tuple<int, int>, std::tuple<int, int>, float> Transition;
+
 	struct FrameVec {
 		bool isStartNode = false;			// is the node the start of a transition
 		bool isEndNode = false;				// is the nodee the end of a transition
 		std::set<FrameID> edges;			// edges of the node (next nodes)
 		std::set<FrameID> directEdges;		// directEdges of the node (next frames)
 		FrameID seqEdge;					// next sequential edge of the node
-		Animation::Frame pose;				// pose of the frame
+		std::map<FrameID, float> edgeCosts;	// distance of the transition edges, sequential edges cost 0
+		Animation::Frame pose;				// root of the frame relative to the previous frame, with all joints for (not lazy) transitions
 		float arclen = 0.0;					// arclen walked. Includes small progress forward
 		glm::vec3 truePos = glm::vec3(0.0f);// true position of the frame in animation
 	};
 
+	// version of the snapshot format, bump when the layout changes
+	static const int SNAPSHOT_VERSION = 6;
+
+	// number of blended transition frames kept in memory with lazy transitions
+	static const int TRANSITION_CACHE_SIZE = 8192;
+
+	// dense id of a frame in the compiled graph, frames are numbered in FrameID order
+	typedef int NodeID;
+
+	// motion along an edge of a node (sequential or transition) up to the next node, precomputed by compile
+	struct EdgeMotion {
+		float dArclen = 0.0f;					// arclength walked, as dEdgeArclength
+		glm::vec3 dPosition = glm::vec3(0.0f);	// position change, as dEdgePosition
+		float dYaw = 0.0f;						// heading change of the root in radians
+		glm::mat4 rootPos = glm::mat4(1.0f);	// root transform at the end of the edge relative to the start,
+		glm::quat rootRot = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);	// use with Animation::unNormaliseTransform
+	};
+
+	// frame along an edge, relative to the start of the edge
+	struct SegmentSample {
+		NodeID frame = -1;
+		float arclen = 0.0f;					// arclength walked since the start of the edge, summed over the frames
+		glm::vec3 offset = glm::vec3(0.0f);		// root position relative to the start, use as Animation::unNormaliseTransform does
+	};
+
+	// motion from a frame to one of its next frames, precomputed by compile
+	struct FrameMotion {
+		NodeID next = -1;
+		float dArclen = 0.0f;					// arclength walked, as dFrameArclength
+	};
+
 	// Constructor
+	// with lazy transitions, the transition frames are not in FrameMat & the snapshot, only in the compiled graph with the
+	// root that the search needs, blended by compile. The full poses are blended on demand by getFrame and kept in a
+	// bounded LRU cache
+	// n_threads = -1 poses & blends the frames on all hardware threads
+	// max_transitions keeps only the cheapest transitions leaving each frame before pruning, -1 keeps all of them
 	Graph(Skeleton* _skeleton, std::vector<Animation*>& animations,
-		std::vector<std::tuple<std::tuple<int, int>, std::tuple<int, int>>>& _edges,
-		const int _window_size);
+		std::vector<Transition>& _edges,
+		const int _window_size, const bool _lazyTransitions = false, const int _n_threads = -1, const int _max_transitions = -1);
+
+	// Load the graph from a snapshot written by saveSnapshot. Throws std::runtime_error if the snapshot is unreadable
+	explicit Graph(const std::string snapshot_path);
+
+	// Write the graph with its skeleton & animations to a binary snapshot
+	// key identifies the inputs the graph was built from and is checked by isSnapshotCurrent
+	void saveSnapshot(const std::string snapshot_path, const std::string key) const;
+
+	// Check if a snapshot exists, is complete, has the current format and was built from the inputs identified by key
+	static bool isSnapshotCurrent(const std::string snapshot_path, const std::string key);
+
+	// Key of the inputs the graph was built from, as given to saveSnapshot. Empty if unknown or the graph was updated since
+	const std::string& getKey() const;
+	void setKey(const std::string _key);
+
+	// Sources the graph was built from, kept in the snapshot: the key of the settings (skeleton, distance version &
+	// parameters) and the content hash of every animation. A graph is patched by Pipeline::updateGraph only if the
+	// settings are the same, an animation with another hash is removed & added again
+	void setSources(const std::string _settingsKey, const std::map<int, std::string>& _animHashes);
+	const std::string& getSettingsKey() const;
+	const std::map<int, std::string>& getAnimationHashes() const;
+
+	// Incrementally update the graph with added & removed animations and the transitions of all new animation pairs
+	// Only the new frames are posed and only the new transitions are blended. The result is identical to a full rebuild
+	// The removed animations are deleted
+	void update(std::vector<Animation*>& addedAnimations, std::vector<int>& removedAnimations,
+		std::vector<Transition>& addedEdges);
+
+	// ========== Read Only Access ==========
+	// All accessors are const and never insert into the graph, so a constructed graph can be shared as a const Graph
+	// by any number of search & playback threads. Lazy transitions are blended through the thread safe LRU cache.
+	// update is the only mutation and must not run while the graph is shared
 
 	// Calculate change in arclength per frame
-	float dFrameArclength(FrameID currFrame, FrameID nextFrame);
+	float dFrameArclength(FrameID currFrame, FrameID nextFrame) const;
 
 	// Calculate change in arclength per edge
-	float dEdgeArclength(FrameID currFrame, FrameID nextFrame);
+	float dEdgeArclength(FrameID currFrame, FrameID nextFrame) const;
 
 	// Calculate change in position per edge
-	glm::vec3 dEdgePosition(FrameID currFrame, FrameID nextFrame);
+	glm::vec3 dEdgePosition(FrameID currFrame, FrameID nextFrame) const;
 
 	// Get the real postion
-	glm::mat4 getRealPos(FrameID frameID);
+	glm::mat4 getRealPos(FrameID frameID) const;
 
 	// Getters
-	Animation::Frame getFrame(FrameID frameID);
-	FrameID getFirstNode();
-	Animation* getAnimation(int animation_id);
-	int getWindowSize();
-	Animation* getRandomAnimation();
-	std::set<FrameID> getEdges(int animID, int indexID);
-	std::set<FrameID> getEdges(FrameID frameID);
-	FrameID getFrameID(int animID, int indexID);
-	const FrameVec& getFrameVec(FrameID frameID);
-	const FrameVec& getFrameVec(int animID, int indexID);
-	Skeleton* getSkeleton();
-	bool isTerminalNode(int animID, int indexID);
-	bool isTerminalNode(FrameID frameID);
-	bool isNode(int animID, int indexID);
-	bool isNode(FrameID frameID);
+	Animation::Frame getFrame(FrameID frameID) const;		// full pose of a frame, blended on demand with lazy transitions
+	FrameID getFirstNode() const;
+	Animation* getAnimation(int animation_id) const;
+	std::vector<int> getAnimationIDs() const;
+	int getWindowSize() const;
+	bool hasLazyTransitions() const;
+	int getMaxTransitions() const;
+	Animation* getRandomAnimation() const;
+	const std::set<FrameID>& getEdges(int animID, int indexID) const;
+	const std::set<FrameID>& getEdges(FrameID frameID) const;
+	FrameID getFrameID(int animID, int indexID) const;
+	const FrameVec& getFrameVec(FrameID frameID) const;		// not for the frames of lazy transitions, see the compiled graph
+	const FrameVec& getFrameVec(int animID, int indexID) const;
+	Skeleton* getSkeleton() const;
+	bool isTerminalNode(int animID, int indexID) const;
+	bool isTerminalNode(FrameID frameID) const;
+	bool isNode(int animID, int indexID) const;
+	bool isNode(FrameID frameID) const;
+
+	// ========== Compiled Graph ==========
+	// Array based view of the graph for the search. Node data is stored as structure of arrays indexed by NodeID and
+	// the adjacency as CSR arrays, so a search step is array indexing instead of tree walks over FrameMat
+	// The edges of a node are ordered by cost: the sequential edge first, then the transitions cheapest first
+	int getNodeCount() const;
+	NodeID getNodeID(FrameID frameID) const;			// -1 if the frame does not exist
+	NodeID getNodeID(int animID, int indexID) const;	// -1 if the frame does not exist
+	const FrameID& getFrameID(NodeID node) const;
+	std::span<const NodeID> getEdges(NodeID node) const;
+	std::span<const NodeID> getEdgeSuccessors(NodeID node) const;	// first frame along each edge, aligned with getEdges
+	std::span<const float> getEdgeCosts(NodeID node) const;			// distance of each edge, aligned with getEdges
+	std::span<const NodeID> getDirectEdges(NodeID node) const;
+	NodeID getSeqEdge(NodeID node) const;				// -1 if there is no sequential edge
+	float getArclen(NodeID node) const;
+	const glm::vec3& getTruePos(NodeID node) const;
+	const glm::mat4& getRootPos(NodeID node) const;
+	const glm::quat& getRootRot(NodeID node) const;
+	bool isNode(NodeID node) const;
+	bool isTransition(NodeID node) const;
+
+	// Precomputed motion tables, aligned with getEdges & getDirectEdges
+	std::span<const EdgeMotion> getEdgeMotions(NodeID node) const;
+	std::span<const FrameMotion> getFrameMotions(NodeID node) const;
+	float getFrameArclength(NodeID currNode, NodeID nextNode) const;	// dFrameArclength from the table, -1 if next is not a next frame
+
+	// Envelope of the motion between two consecutive frames of any path through the graph: the largest change in
+	// arclength & the largest horizontal root displacement. A search moves at most k times as far in k frames
+	float getMaxFrameArclength() const;
+	float getMaxFrameDisplacement() const;
+
+	// Segment view: every edge of a node is a whole clip segment or transition up to the next node, with one sample per
+	// frame (the target last), so a search can step edge by edge and still evaluate its cost per frame
+	std::span<const SegmentSample> getEdgeSamples(NodeID node, int edge) const;
+
+	// Sample the frames from first (the next frame of start) up to target, or up to the next node if target is -1
+	// Appends a sample per frame, sets the root transform at the last frame relative to start & returns the last frame
+	NodeID sampleSegment(NodeID start, NodeID first, NodeID target, std::vector<SegmentSample>& samples, glm::mat4& rootPos, glm::quat& rootRot) const;
+
+	// Compiled equivalents of dFrameArclength, dEdgeArclength & dEdgePosition
+	float dFrameArclength(NodeID currNode, NodeID nextNode) const;
+	float dEdgeArclength(NodeID currNode, NodeID nextNode) const;
+	glm::vec3 dEdgePosition(NodeID currNode, NodeID nextNode) const;
 
 	// Output to string
-	std::string toString(bool print = false);
+	std::string toString(bool print = false) const;
 	static std::string toString(FrameID frameID);
-	void toFile(bool print = false);
+	void toFile(bool print = false) const;
 
 
 private:
 	// Attributes
 	Skeleton* skeleton;
 	int window_size;
+	bool lazyTransitions = false;
+	int n_threads = -1;
+	int maxTransitions = -1;
+	std::string key;
+	std::string settingsKey;
+	std::map<int, std::string> animHashes;	// animID -> content hash of the animation file
+	std::shared_ptr<LRUCache<FrameID, Animation::Frame>> transitionCache;	// blended poses of lazy transitions
 	std::map<int, Animation*> anim_database;
 	std::map<FrameID, FrameVec> FrameMat;
+	std::vector<Transition> transitions;	// unpruned transitional edges
 	const float SMALL_INCREMENT = 0.01;
 
+	// compiled graph
+	enum NodeFlags : std::uint8_t {
+		START_NODE = 1 << 0,
+		END_NODE = 1 << 1,
+		TRANSITION = 1 << 2
+	};
+	std::vector<FrameID> nodeFrameIDs;		// NodeID -> FrameID, sorted
+	std::vector<NodeID> animOffsets;		// animID -> NodeID of the first frame of the animation, -1 if it does not exist
+	std::vector<int> animFrameCounts;		// animID -> number of frames of the animation
+	std::vector<int> edgeOffsets;			// CSR offsets into edgeTargets & edgeSuccessors, size N + 1
+	std::vector<NodeID> edgeTargets;
+	std::vector<NodeID> edgeSuccessors;
+	std::vector<float> edgeCosts;
+	std::vector<int> directOffsets;			// CSR offsets into directTargets, size N + 1
+	std::vector<NodeID> directTargets;
+	std::vector<EdgeMotion> edgeMotions;	// aligned with edgeTargets
+	std::vector<FrameMotion> frameMotions;	// aligned with directTargets
+	std::vector<int> sampleOffsets;			// CSR offsets into segmentSamples per edge, size edgeTargets.size() + 1
+	std::vector<SegmentSample> segmentSamples;
+	float maxFrameArclength = 0.0f;
+	float maxFrameDisplacement = 0.0f;
+	std::vector<NodeID> nodeSeqEdges;
+	std::vector<float> nodeArclens;
+	std::vector<glm::vec3> nodeTruePos;
+	std::vector<glm::mat4> nodeRootPos;
+	std::vector<glm::quat> nodeRootRot;
+	std::vector<std::uint8_t> nodeFlags;
+
+	void compile();
+	void compileMotions();
+
+	void addAnimation(Animation* animation);
+	void removeAnimation(int animID);
+	void build();
+	void poseAnimation(int animID);
+	void blendTransition(FrameID node, FrameID nextNode);
+	void blendFrame(FrameID tFrameID, const FrameVec* prevFrameVec, FrameVec& frameVec) const;
+	FrameID transitionFrame(FrameID node, FrameID nextNode, int alpha) const;
 	void pruneGraph();
-	Animation::Frame blend(FrameID transID, int windowSize);
+	Animation::Frame blend(FrameID transID, int windowSize, bool rootOnly = false) const;
+};
+
+// hash of the packed key (splitmix64 finaliser), so frames can key unordered containers
+template <>
+struct std::hash<Graph::FrameID> {
+	size_t operator()(const Graph::FrameID& frameID) const noexcept {
+		std::uint64_t key = frameID.pack();
+		key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+		return size_t(key ^ (key >> 31));
+	}
 };
 
 
 
 
 
+
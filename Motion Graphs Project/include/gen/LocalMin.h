@@ -2,11 +2,13 @@
 
 #include <vector>
 #include <tuple>
+#include <cmath>
 #include <iostream>
 
 class LocalMin
 {
 public:
-	static std::vector<std::tuple<int, int>> localMinima(std::vector<std::vector<float>> distance_2d, int threshold, int STEP_SIZE);
+	// returns (i * STEP_SIZE, j * STEP_SIZE, distance) of every local minimum
+	static std::vector<std::tuple<int, int, float>> localMinima(std::vector<std::vector<float>> distance_2d, int threshold, int STEP_SIZE);
 };
 
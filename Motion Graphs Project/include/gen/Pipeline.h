@@ -5,20 +5,48 @@
 #include <fstream>
 #include <sstream>
 #include <filesystem>
+#include <set>
+#include <map>
+#include <chrono>
 
 #include <core/Animation.h>
+#include <core/Scheduler.h>
 #include <gen/LocalMin.h>
 #include <gen/Graph.h>
 #include <gen/Distance.h>
+#include <gen/DistanceCache.h>
 
 class Pipeline
 {
 private:
-	static void saveDistanceToFile(std::vector<std::vector<float>> distance, std::string filename);
-	static std::vector<std::vector<float>> loadDistanceFromFile(std::string filename);
+	static void findMotionFiles(const std::string mocap_dir, std::string& asf_file, std::vector<std::string>& amc_files);
+	static int getAnimationID(const std::string amc_file);
+	static void genEdges(Skeleton* skeleton, const std::string asf_file, const std::vector<std::string>& amc_files, const std::set<int>& onlyWith,
+		const int WINDOW_SIZE, const int THRESHOLD, const int STEP_SIZE, const std::string distance_dir, const int N_THREADS,
+		std::vector<Animation*>& animations, std::vector<Graph::Transition>& edges);
+	static std::map<int, std::string> hashMotionFiles(const std::vector<std::string>& amc_files);	// animation id -> content hash
+	static std::string settingsKey(const std::string asf_file, const int WINDOW_SIZE, const int THRESHOLD, const int STEP_SIZE, const bool LAZY_TRANSITIONS, const int MAX_TRANSITIONS);
+	static std::string snapshotKey(const std::string settings_key, const std::map<int, std::string>& amc_hashes);
 
 public:
-	static Graph genGraph(const int WINDOW_SIZE, const int THRESHOLD, const int STEP_SIZE, const std::string graphdir);
+	// read a graph config of [KEY] [VALUE] lines (id, window_size, threshold, step_size, lazy_transitions, max_transitions)
+	static std::map<std::string, int> loadGraphConfig(const std::string config_path);
+
+	// cachedir defaults to [graphdir]/distance/. As the cache is content-addressed, it can be shared between subjects
+	// N_THREADS = -1 uses all hardware threads
+	// LAZY_TRANSITIONS blends the poses of transition frames on demand instead of storing them, see Graph
+	// MAX_TRANSITIONS keeps only the cheapest transitions leaving each frame, -1 keeps all of them
+	static Graph genGraph(const int WINDOW_SIZE, const int THRESHOLD, const int STEP_SIZE, const std::string graphdir, const std::string cachedir = "", const int N_THREADS = -1, const bool LAZY_TRANSITIONS = false, const int MAX_TRANSITIONS = -1);
+
+	// load the graph from [graphdir]/graph.snapshot if it was built from the same files & parameters
+	// if only the animations changed, the snapshot is patched with updateGraph, otherwise the graph is generated with genGraph
+	// either way a new snapshot is written
+	static Graph loadGraph(const int WINDOW_SIZE, const int THRESHOLD, const int STEP_SIZE, const std::string graphdir, const std::string cachedir = "", const int N_THREADS = -1, const bool LAZY_TRANSITIONS = false, const int MAX_TRANSITIONS = -1);
+
+	// rescan [graphdir]/mocap/ and patch the graph with the added, removed & changed animations
+	// only the distance matrices of the new animation pairs are loaded or generated
+	// returns false & leaves the graph as it is if it was built with other settings, which needs a full rebuild
+	static bool updateGraph(Graph& graph, const int WINDOW_SIZE, const int THRESHOLD, const int STEP_SIZE, const std::string graphdir, const std::string cachedir = "", const int N_THREADS = -1);
 
 };
 
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <gen/Graph.h>
+#include <gen/DistanceCache.h>
+#include <gen/FileIndex.h>
+
+#include <vector>
+#include <map>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <filesystem>
+#include <cstdint>
+#include <cmath>
+#include <glm/glm.hpp>
+
+// content-addressed cache of planned paths, one .plan file per path
+// entries are keyed by the graph key, the start frame, the search & the points of the path relative to the start, so
+// the same path followed from the same frame is planned once, wherever it is drawn or loaded
+// a plan is stored as runs of frames along the first next frame of each, a run as the FrameID of its first frame & its length
+// the cache directory can be shared by several processes, see FileIndex
+// load & store are thread safe
+class PlanCache
+{
+public:
+	static const int VERSION = 1;
+	static constexpr float POINT_QUANTUM = 0.001f;	// points closer than this hash the same
+	static const long long DEFAULT_QUOTA = 64LL * 1024 * 1024;	// 64MB
+
+	PlanCache(const std::string _cachedir, const long long _quota = DEFAULT_QUOTA);
+
+	// Generate the key of a plan. points are the points of the path relative to the root at the start, facing +z
+	// search describes the search settings that change the plan. Empty if the graph has no key
+	static std::string makeKey(const Graph& graph, Graph::FrameID start, const std::vector<glm::vec3>& points, float pathRadius, const std::string search);
+
+	// Load / store the nodes of a plan. load returns false on a miss, including an entry that was evicted, is
+	// unreadable or does not fit the graph. A plan that cannot be written is not cached
+	bool load(const std::string key, const Graph& graph, std::vector<Graph::NodeID>& nodes);
+	void store(const std::string key, const Graph& graph, const std::vector<Graph::NodeID>& nodes);
+
+private:
+	FileIndex index;	// the .plan files & their last used times
+
+	static bool loadPlanFromFile(std::string filename, long long size, const Graph& graph, std::vector<Graph::NodeID>& nodes);
+	static Graph::NodeID firstNext(const Graph& graph, Graph::NodeID node);	// -1 if the frame has no next frame
+};
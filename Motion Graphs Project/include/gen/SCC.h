@@ -0,0 +1,33 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+
+// Strongly connected components of a graph given as CSR arrays: the edges of node v are
+// targets[offsets[v]] ... targets[offsets[v + 1] - 1]
+// Both return the component id of every node
+class SCC
+{
+public:
+	// graphs with at least this many nodes use the parallel forward-backward algorithm
+	static const int PARALLEL_THRESHOLD = 1 << 20;
+
+	// Iterative Tarjan, O(V + E) and independent of the call stack depth
+	static std::vector<int> tarjan(const std::vector<int>& offsets, const std::vector<int>& targets);
+
+	// Forward-backward with trimming. The reachability searches expand large frontiers on n_threads threads
+	// n_threads = -1 uses all hardware threads
+	static std::vector<int> forwardBackward(const std::vector<int>& offsets, const std::vector<int>& targets, int n_threads = -1);
+
+	// Id of the largest component, ties go to the component of the lowest node
+	static int largest(const std::vector<int>& components);
+
+private:
+	// frontiers with at least this many nodes are expanded in parallel
+	static const int PARALLEL_FRONTIER = 1 << 14;
+
+	static void reach(const int pivot, const int color, const int epoch, const std::vector<int>& offsets, const std::vector<int>& targets,
+		const std::vector<int>& colors, std::vector<std::atomic<int>>& marks, const int n_threads);
+};
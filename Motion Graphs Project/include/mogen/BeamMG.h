@@ -0,0 +1,68 @@
+#pragma once
+
+#include <gen/Graph.h>
+#include <mogen/MotionGenerator.h>
+
+#include <vector>
+#include <algorithm>
+
+// Follows the path with a beam search over the frames of the graph. At every depth only the beamWidth partial paths
+// with the lowest cost are kept, the cost being the sum of squared distances to the path as in KovarMG
+// The search takes time linear in the length of the path & the beam width, at the price of optimality
+class BeamMG : public MotionGenerator
+{
+private:
+
+	// partial path kept in the beam
+	struct Beam {
+		Graph::NodeID node;
+		glm::mat4 position;
+		glm::quat rotation;
+		float arclen = 0;
+		float cost = 0;
+		int trail = 0;						// index of the last frame in the trail
+	};
+
+	// next frame of a partial path, the cost only depends on the frame it leaves
+	struct Candidate {
+		float cost;
+		int parent;							// index into the beam
+		Graph::NodeID next;
+	};
+
+	std::vector<Graph::NodeID> path;
+	int pathIdx = 0;
+	int beamWidth = 1024;
+
+	// statistics of the last path
+	double planningTime = 0;
+	float pathError = 0;
+	long long expandedFrames = 0;
+
+	// search memory, kept between searches
+	std::vector<Beam> beam;
+	std::vector<Beam> nextBeam;
+	std::vector<Candidate> candidates;
+	std::vector<std::pair<Graph::NodeID, int>> trail;	// (frame, index of the previous frame) of every partial path
+	std::vector<int> trailMap;							// index of the frames kept by compactTrail
+	const int TRAIL_PER_WIDTH = 64;						// trail entries per beam width before the first compaction
+
+	void searchPath(Graph::NodeID start_node, const std::vector<glm::vec3>& pathline, float pathRadius);
+	void compactTrail(int& best);
+
+public:
+	BeamMG(const Graph* _graph, int _beamWidth = 1024) : MotionGenerator(_graph) {
+		beamWidth = std::max(1, _beamWidth);
+	}
+
+	void setPath(const std::vector<float>& line);
+	void setBeamWidth(int _beamWidth);
+	std::vector<float> getNextFrame(bool* completed = NULL);
+	glm::vec4 getColour();
+	void reset();
+
+	// statistics of the last path, printed with the names KovarMG uses so the two can be compared
+	double getPlanningTime() const;		// seconds
+	float getPathError() const;
+	long long getExpandedFrames() const;
+};
@@ -1,15 +1,32 @@
 #pragma once
 
 #include <gen/Graph.h>
+#include <gen/PlanCache.h>
 #include <mogen/MotionGenerator.h>
 
+#include <atomic>
+#include <optional>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <limits>
+
 class KovarMG : public MotionGenerator
 {
+public:
+	// FRAME expands one frame per search state. SEGMENT expands a whole edge (clip segment or transition) per state
+	// and evaluates the cost of its frames from the segment view of the graph, with the same cost semantics
+	enum class SearchMode {
+		FRAME,
+		SEGMENT
+	};
+
 private:
 	
 	struct State {
-		std::vector<Graph::FrameID> nextFrames;
-		const Graph::FrameID frameID;
+		int nextFrames = 0;				// sorted next frames of the state in the FRAME search arena
+		int n_nextFrames = 0;
+		const Graph::NodeID frameID;
 		const glm::mat4 position;
 		const glm::quat rotation;
 		const float arclen = 0;
@@ -18,7 +35,7 @@ private:
 		int index = 0;
 
 		State(
-			Graph::FrameID _frameID,
+			Graph::NodeID _frameID,
 			glm::mat4 _position,
 			glm::quat _rotation,
 			float _arclen,
@@ -34,26 +51,208 @@ private:
 
 	struct Path {
 		std::vector<State> stack;
-		std::vector<Graph::FrameID> nodes;
+		std::vector<Graph::NodeID> nodes;
+		bool optimal = true;			// false if the search ran out of budget before it proved the path is the best
+	};
+
+	// search state at a node in SEGMENT mode
+	struct Segment {
+		int edges = 0;								// (distance, edge) sorted by distance in the arena of the search thread,
+		int n_edges = 0;							// edge -1 is the path to the next node
+		Graph::NodeID node;
+		glm::mat4 position;
+		glm::quat rotation;
+		float arclen = 0;
+		float cost = 0;
+		float error = 0;							// pathCost at the node, the next cost of every edge
+		float estimate = 0;							// lower bound on the cost of the paths through the node
+		int depth = 0;
+		int edge = -1;								// edge of the previous node leading here
+		int index = 0;
+	};
+
+	// segment reached by a SEGMENT search, by node & quantised root position, yaw & arclength
+	struct Transposition {
+		Graph::NodeID node = -1;
+		int x = 0;
+		int z = 0;
+		int yaw = 0;
+		int arclen = 0;
+		float cost = 0;					// lowest cost the segment was reached with
+		int depth = 0;					// & its remaining depth
+		unsigned int generation = 0;	// entries of earlier searches are empty
+	};
+
+	// edge taken by a SEGMENT search & the number of its frames used
+	struct Step {
+		int edge;
+		int frames;
+	};
+
+	struct Window;
+
+	// inputs of a SEGMENT search, read by all search threads
+	struct SegmentSearch {
+		const std::vector<glm::vec3>& pathline;
+		float pathRadius;
+		std::vector<Graph::SegmentSample> firstSamples;	// path to the next node when the search resumes in between nodes
+		glm::mat4 firstPos;
+		glm::quat firstRot;
+
+		// bounds of costBound: per frame, the error shrinks by at most errorRate, the arclength grows by at most
+		// arclenRate & the root moves by at most moveRate
+		float errorRate = 0;
+		float arclenRate = 0;
+		float moveRate = 0;
+
+		// budget of the search, the best path so far is returned once either runs out
+		std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+		long long maxExpanded = -1;
+
+		Window* window = nullptr;			// window searched on its own thread when speculating
 	};
 
-	Path path;
+	// memory of a search thread, reused by every search so the search itself does not allocate
+	// the children of the states on the stack are bump allocated in the arena and released when the state is popped
+	struct Workspace {
+		std::vector<Segment> stack;
+		std::vector<std::pair<float, int>> arena;
+		std::vector<Transposition> transpositions;	// transposition table of the subtrees searched by the thread
+		unsigned int generation = 0;
+		long long transpositionHits = 0;
+		long long transpositionMisses = 0;
+	};
+
+	// memory of a SEGMENT search, kept between searches
+	struct SegmentMemory {
+		std::vector<Workspace> workspaces;		// one per search thread
+		std::vector<Segment> tasks;				// subtrees of the search, a root-to-subtree stack each
+		std::vector<Segment> splitTasks;
+		std::vector<int> taskOffsets;
+		std::vector<int> splitOffsets;
+	};
+
+	// best path found by any search thread. Ties go to the path the serial search reaches first, which is the path
+	// with the lexicographically smallest edge indices, so the result does not depend on the number of threads
+	struct Incumbent {
+		std::atomic<float> bound = std::numeric_limits<float>::max();	// cost of the best path, read without the lock to prune
+		std::mutex mutex;
+		float cost = std::numeric_limits<float>::max();
+		std::vector<int> order;			// index into the sorted edges at every segment of the best path
+		std::vector<Step> steps;
+		std::vector<Step> previous;		// steps of the previous best path
+		std::atomic<long long> expanded = 0;	// edges evaluated
+		std::atomic<bool> stopped = false;		// the budget ran out, all threads stop
+
+		// when speculating, the number of times the KEEP frames of the best path changed & when they last did
+		std::atomic<int> prefixVersion = 0;
+		std::atomic<long long> prefixSince = 0;
+	};
+
+	// SEGMENT search of a window on its own thread, when the next window is planned speculatively
+	// While a window is searched, the next one is searched from the end of the KEEP frames of its best path once they
+	// have not changed for SPECULATE_AFTER expansions, & searched again whenever they change after that
+	// The speculative search is kept if the same frames are committed, which gives the same path as searching it then
+	struct Window {
+		Path start;								// the frames before the window, the last is its first frame
+		Path result;
+		SegmentMemory memory;
+		std::thread thread;
+		std::atomic<bool> discarded = false;	// stops the search
+		std::atomic<bool> speculative = false;	// the frames before the window are not committed yet
+		std::mutex mutex;						// held while the next window is started
+		std::atomic<int> speculatedVersion = 0;	// prefix version the next window was started from, written under mutex
+		Window* next = nullptr;
+	};
+
+	Path path;								// path of the planner, read by playback once the planner is joined
 	std::vector<Graph::FrameID> pathnodes;
  	int pathIdx = 0;
-	const int FPS = 120;
+
+	// the path is planned on the planner thread, which commits the frames of every window as soon as it is searched
+	// getNextFrame plays the committed frames, so playback starts after the first window instead of the whole path
+	std::thread planner;
+	std::mutex planMutex;
+	std::vector<Graph::NodeID> committed;	// guarded by planMutex
+	std::vector<float> committedArclens;	// guarded by planMutex, arclength of the committed frames along the path
+	bool planning = false;					// guarded by planMutex, more frames are still to be committed
+	std::atomic<bool> cancelled = false;	// stops the planner, the window it is searching is dropped
+
+	// pathline the path was planned for. A new pathline keeps the windows whose search did not reach the part that
+	// changed & the frames already played, and only the rest is planned again
+	std::vector<glm::vec3> plannedLine;
+	float plannedRadius = 0;
+
+	// complete paths planned from the start within budget, replayed when the same path is set from the same frame
+	std::optional<PlanCache> planCache;
+
 	const int SEARCH = FPS * 2;
 	const int KEEP = SEARCH * 0.5;
-	const int MARGIN = 3;
-	const int MAX_PATH_LENGTH = FPS * 60 * 10;
+	SearchMode searchMode = SearchMode::SEGMENT;
+	int n_threads = -1;
+	const int TASKS_PER_THREAD = 16;
+	const int BUDGET_CHECK = 64;		// expansions between reads of the clock
+	const int SPECULATE_AFTER = 1024;	// expansions the KEEP frames of the best path are unchanged before speculating
+	std::atomic<long long> expandedSegments = 0;	// edges evaluated by the SEGMENT searches of the current path
+	int cutWindows = 0;					// windows of the current path whose search ran out of budget
+	long long expandedStates = 0;		// states pushed by the FRAME search of the current path
+	bool speculation = false;
+	int speculatedWindows = 0;			// windows of the current path taken from a speculative search
 
-	void searchPath(Graph::FrameID start_node, const std::vector<glm::vec3>& pathline, float pathRadius);
+	// transposition table of the SEGMENT search, a fixed number of entries per search thread replaced on collision
+	// a segment is pruned if the same node was reached within the quanta with no higher cost & no more remaining depth
+	// Segments within the quanta are only close, so the table may prune the best path, & with more than one thread
+	// each thread only prunes the subtrees it searched itself
+	bool transpositionTable = false;
+	const int TRANSPOSITIONS = 1 << 16;
+	const float POSITION_QUANTUM = 0.5f;
+	const float YAW_QUANTUM = glm::radians(10.0f);
+	const float ARCLEN_QUANTUM = 1.0f;
+	std::atomic<long long> transpositionHits = 0;
+	std::atomic<long long> transpositionMisses = 0;
+
+	// budget of every search window, -1 is unlimited. May be changed while a path is planned
+	std::atomic<int> budgetMs = -1;
+	std::atomic<long long> budgetExpansions = -1;
+
+	// search memory, kept between searches
+	SegmentMemory segmentMemory;
+	Window windows[2];						// the window being searched & the speculative search of the next one
+	std::vector<State> frameStack;			// FRAME search
+	std::vector<Graph::NodeID> frameNodes;
+	std::vector<Graph::NodeID> frameArena;
+	std::vector<std::pair<float, int>> frameOrder;
+	std::vector<Graph::NodeID> bestNodes;	// best path of the FRAME search as the trail of its frames
+
+	void searchPath(const std::vector<glm::vec3>& pathline, float pathRadius);
+	int validFrames(const std::vector<glm::vec3>& pathline, float pathRadius);
+	std::string planKey(const std::vector<glm::vec3>& pathline, float pathRadius);
+	void commit(bool done);
+	void cancelPath();
+	Path iterateSegments(const Path& globalPath, const std::vector<glm::vec3>& pathline, float pathRadius, SegmentMemory& memory, Window* window);
+	Path nextWindow(Window*& window, const std::vector<glm::vec3>& pathline, float pathRadius);
+	void speculate(const SegmentSearch& search, Incumbent& incumbent);
+	bool transposed(Workspace& workspace, const Segment& segment);
+	void discard(Window& window);
+	void expandSteps(const std::vector<Step>& steps, int frames, const SegmentSearch& search, Path& localPath);
+	bool samePrefix(const std::vector<Step>& a, const std::vector<Step>& b);
+	using MotionGenerator::pathCost;
+	using MotionGenerator::isComplete;
 	float pathCost(const State& currState, const std::vector<glm::vec3>& pathline, float pathRadius);
 	bool isComplete(const Path& localPath, const std::vector<glm::vec3>& pathline);
-	State nextState(const State& currState, const std::vector<glm::vec3>& pathline, float pathRadius, Graph::FrameID nextFrame);
-	glm::vec3 getTruePos(float arclen, float pathRadius, const std::vector<glm::vec3>& pathline);
+	State stepState(const State& currState, const std::vector<glm::vec3>& pathline, float pathRadius, Graph::NodeID nextFrame);
+	bool advance(Workspace& workspace, const SegmentSearch& search, Incumbent& incumbent, Segment& next);
+	void searchSegments(Workspace& workspace, const SegmentSearch& search, Incumbent& incumbent);
+	void segmentEdges(Segment& segment, Workspace& workspace, const SegmentSearch& search);
+	static bool precedes(const std::vector<int>& order, const std::vector<Segment>& stack);
+	bool outOfBudget(const SegmentSearch& search, Incumbent& incumbent);
+	bool prunes(float cost, const std::vector<Segment>& stack, Incumbent& incumbent);
+	float costBound(float cost, float error, const glm::vec3& position, float arclen, int depth, const SegmentSearch& search);
+	void offer(float cost, const std::vector<Segment>& stack, int edge, int frames, const SegmentSearch& search, Incumbent& incumbent);
+	void sortedEdges(Graph::NodeID node, const glm::mat4& position, float arclen, const std::vector<glm::vec3>& pathline, float pathRadius, std::vector<std::pair<float, int>>& order);
 
 public:
-	KovarMG(Graph* _graph) : MotionGenerator(_graph) {
+	KovarMG(const Graph* _graph) : MotionGenerator(_graph) {
 		// [WIP]
 		// initialise path point buffer
 		Buffer pathPointBuffer;
@@ -73,9 +272,22 @@ public:
 		buffers["rootPoint"] = rootPointBuffer;
 	}
 
-	void setPath(const std::vector<float>& line);
+	~KovarMG();
+
+	void setPath(const std::vector<float>& line);	// plans the path in the background & returns immediately
+	bool replans() { return true; }
+	int getPlayedFrames();
+	float getPlayedArclength();
+	void waitForPath();								// blocks until the path is planned
+	void setSearchMode(SearchMode mode);
+	void setThreads(int _n_threads);		// threads of the SEGMENT search, -1 uses all hardware threads
+	void setBudget(int milliseconds, long long expansions = -1);	// budget of every search window, -1 is unlimited
+	void setSpeculation(bool _speculation);	// search the next SEGMENT window while the current one is searched
+	void setTranspositions(bool _transpositionTable);	// prune revisits of equivalent segments in the SEGMENT search
+	void setPlanCache(const std::string cachedir);		// keep planned paths in cachedir, "" disables the cache
 	Path iterateBnB(const Path& globalPath, const std::vector<glm::vec3>& pathline, float pathRadius);
-	std::vector<Graph::FrameID> sortedNextFrames(State currState, const std::vector<glm::vec3>& pathline, float pathRadius);
+	Path iterateSegments(const Path& globalPath, const std::vector<glm::vec3>& pathline, float pathRadius);
+	void sortedNextFrames(State& currState, const std::vector<glm::vec3>& pathline, float pathRadius, std::vector<Graph::NodeID>& arena);
 	std::vector<float> getNextFrame(bool* completed = NULL);
 	glm::vec4 getColour();
 	void reset();
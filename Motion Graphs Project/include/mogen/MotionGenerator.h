@@ -3,6 +3,8 @@
 #include <gen/Graph.h>
 
 #include <vector>
+#include <cmath>
+#include <stdexcept>
 #include <glm/glm.hpp>
 
 class MotionGenerator
@@ -15,10 +17,10 @@ public:
 		glm::vec4 colour;
 	};
 
-	MotionGenerator(Graph* _graph) {
+	MotionGenerator(const Graph* _graph) {
 		graph = _graph;
 		currFrameID = graph->getFirstNode();
-		currFrame = Animation::Frame(graph->getFrameVec(currFrameID).pose);
+		currFrame = graph->getFrame(currFrameID);
 		currFrame.pos[3][1] = graph->getRealPos(currFrameID)[3][1];
 		currPos = currFrame.pos;
 		currRot = currFrame.pose["root"];
@@ -34,11 +36,20 @@ public:
 
 	virtual void setPath(const std::vector<float>& line) { /* Do Nothing */ };
 
+	// setPath may be called while the path is played, the generator keeps what it can of the path & playback
+	virtual bool replans() { return false; }
+
+	// frames of the current path played since it started or looped, -1 if the generator does not track them
+	virtual int getPlayedFrames() { return -1; }
+
+	// arclength along the path of the last frame played, the path before it is no longer planned
+	virtual float getPlayedArclength() { return 0.0f; }
+
 	virtual void getDrawBuffers() { /* Do Nothing */ };
 
 	virtual void reset() {
 		currFrameID = graph->getFirstNode();
-		currFrame = Animation::Frame(graph->getFrameVec(currFrameID).pose);
+		currFrame = graph->getFrame(currFrameID);
 		currFrame.pos[3][1] = graph->getRealPos(currFrameID)[3][1];
 		currPos = currFrame.pos;
 		currRot = currFrame.pose["root"];
@@ -47,7 +58,60 @@ public:
 	virtual std::vector<float> getNextFrame(bool *completed=NULL) = 0;
 
 protected:
-	Graph* graph;
+	static constexpr int FPS = 120;
+	static constexpr int MARGIN = 3;					// a path is complete within MARGIN of its end
+	static constexpr int MAX_PATH_LENGTH = FPS * 60 * 10;	// frames, -1 is unlimited
+
+	// error of a root position to the path, the distance on the floor to the point of the path at its arclength
+	float pathCost(const glm::vec3& position, float arclen, const std::vector<glm::vec3>& pathline, float pathRadius) const {
+		glm::vec3 currPos = glm::vec3(position[0], 0.0f, position[2]);
+		glm::vec3 truePos = getTruePos(arclen, pathRadius, pathline);
+
+		float distance = glm::distance(currPos, truePos);
+
+		if (std::isnan(distance)) {
+			throw std::runtime_error("Distance is nan!");
+		}
+
+		return distance;
+	}
+
+	bool isComplete(const glm::vec3& position, float arclen, const std::vector<glm::vec3>& pathline) const {
+
+		glm::vec3 lastPos = pathline.back();
+		glm::vec3 currPos = position;
+		currPos[1] = 0.0f;	// cast to floor
+
+		bool isClose = glm::distance(currPos, lastPos) < MARGIN;
+		bool isGoodLength = arclen > pathline.size() * 0.9;
+
+		return isClose && isGoodLength;
+	}
+
+	// point of the path at the arclength, the points of the path are evenly spaced by pathRadius
+	glm::vec3 getTruePos(float arclen, float pathRadius, const std::vector<glm::vec3>& pathline) const {
+
+		// get index in float
+		float indexf = arclen / pathRadius;
+
+		// get real index and its remainder
+		int index = floor(indexf);
+		float remainder = indexf - index;
+
+		if (index + 1 < (int)pathline.size()) {
+			// get the two start and end points that indexf lies in
+			glm::vec3 S = pathline[index];
+			glm::vec3 E = pathline[index + 1];
+
+			// interpolate between them
+			return S * (1 - remainder) + E * (remainder);
+		}
+		else {
+			return pathline.back();
+		}
+	}
+
+	const Graph* graph;
 	Graph::FrameID currFrameID;
 	Animation::Frame currFrame;
 	glm::mat4 currPos = glm::mat4(1.0f);
@@ -6,7 +6,7 @@ class RandomMG : public MotionGenerator
 {
 
 public:
-	RandomMG(Graph* _graph) : MotionGenerator(_graph) {}
+	RandomMG(const Graph* _graph) : MotionGenerator(_graph) {}
 	std::vector<float> getNextFrame(bool* completed = NULL);
 	glm::vec4 getColour();
 };
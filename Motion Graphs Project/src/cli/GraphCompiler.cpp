@@ -0,0 +1,203 @@
+// Headless graph compiler
+// Runs the full pipeline without a window or any user input and writes the distance cache and the graph snapshot
+// that the interactive application loads at startup. Meant for batch machines and nightly jobs without a display.
+//
+// usage: graph_compiler --graph <graphdir> [--config <file>] [--window <n>] [--threshold <n>] [--step <n>]
+//                       [--threads <n>] [--cache <dir>] [--max-transitions <n>] [--lazy] [--force] [--verify]
+//
+// the parameters default to [graphdir]/config.txt, flags override the config
+
+#include <gen/Pipeline.h>
+
+#include <iostream>
+#include <string>
+#include <map>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+
+static void printUsage() {
+	std::cout << "usage: graph_compiler --graph <graphdir> [--config <file>] [--window <n>] [--threshold <n>] [--step <n>]" << std::endl;
+	std::cout << "                      [--threads <n>] [--cache <dir>] [--max-transitions <n>] [--lazy] [--force] [--verify]" << std::endl;
+	std::cout << std::endl;
+	std::cout << "  --graph      graph directory containing mocap/ (e.g. data/graphs/graph91/)" << std::endl;
+	std::cout << "  --config     graph config, defaults to [graphdir]/config.txt" << std::endl;
+	std::cout << "  --window     window size of the distance & blend window" << std::endl;
+	std::cout << "  --threshold  local minima threshold, -1 keeps all local minima" << std::endl;
+	std::cout << "  --step       step size of the distance matrix" << std::endl;
+	std::cout << "  --threads    number of threads, defaults to all hardware threads" << std::endl;
+	std::cout << "  --cache      distance cache directory, defaults to [graphdir]/distance/" << std::endl;
+	std::cout << "  --max-transitions  keep only the n cheapest transitions leaving each frame, -1 keeps all" << std::endl;
+	std::cout << "  --lazy       store only the root of transition frames and blend their poses on demand" << std::endl;
+	std::cout << "  --force      rebuild the graph even if the snapshot is up to date" << std::endl;
+	std::cout << "  --verify     rebuild the graph in full & check its snapshot is the same as the one loaded or updated" << std::endl;
+}
+
+// true if both files have the same bytes
+static bool sameFiles(const std::string path1, const std::string path2) {
+	std::ifstream file1(path1, std::ios::binary);
+	std::ifstream file2(path2, std::ios::binary);
+	if (!file1.is_open() || !file2.is_open()) {
+		return false;
+	}
+
+	return std::equal(std::istreambuf_iterator<char>(file1), std::istreambuf_iterator<char>(),
+		std::istreambuf_iterator<char>(file2), std::istreambuf_iterator<char>());
+}
+
+int main(int argc, char* argv[]) {
+	auto start = std::chrono::steady_clock::now();
+
+	// ========== Parse the flags ==========
+	std::string graphdir;
+	std::string config_path;
+	std::string cachedir;
+	std::map<std::string, int> params;
+	int n_threads = -1;
+	bool force = false;
+	bool verify = false;
+
+	for (int i = 1; i < argc; i++) {
+		std::string flag = argv[i];
+
+		if (flag == "--help" || flag == "-h") {
+			printUsage();
+			return 0;
+		}
+		else if (flag == "--force") {
+			force = true;
+			continue;
+		}
+		else if (flag == "--verify") {
+			verify = true;
+			continue;
+		}
+		else if (flag == "--lazy") {
+			params["lazy_transitions"] = 1;
+			continue;
+		}
+
+		// all other flags take a value
+		if (i + 1 >= argc) {
+			std::cout << "Error, Missing Value for " << flag << std::endl;
+			printUsage();
+			return 1;
+		}
+		std::string value = argv[++i];
+
+		try {
+			if (flag == "--graph") {
+				graphdir = value;
+			}
+			else if (flag == "--config") {
+				config_path = value;
+			}
+			else if (flag == "--cache") {
+				cachedir = value;
+			}
+			else if (flag == "--window") {
+				params["window_size"] = std::stoi(value);
+			}
+			else if (flag == "--threshold") {
+				params["threshold"] = std::stoi(value);
+			}
+			else if (flag == "--step") {
+				params["step_size"] = std::stoi(value);
+			}
+			else if (flag == "--max-transitions") {
+				params["max_transitions"] = std::stoi(value);
+			}
+			else if (flag == "--threads") {
+				n_threads = std::stoi(value);
+			}
+			else {
+				std::cout << "Error, Unknown Flag " << flag << std::endl;
+				printUsage();
+				return 1;
+			}
+		}
+		catch (const std::logic_error&) {
+			std::cout << "Error, Invalid Value " << value << " for " << flag << std::endl;
+			return 1;
+		}
+	}
+
+	if (graphdir.empty()) {
+		printUsage();
+		return 1;
+	}
+
+	// the pipeline concatenates paths, so directories need a trailing slash
+	if (graphdir.back() != '/') {
+		graphdir += "/";
+	}
+	if (!cachedir.empty() && cachedir.back() != '/') {
+		cachedir += "/";
+	}
+
+	// ========== Read the config ==========
+	if (config_path.empty() && std::filesystem::exists(graphdir + "config.txt")) {
+		config_path = graphdir + "config.txt";
+	}
+
+	if (!config_path.empty()) {
+		auto config = Pipeline::loadGraphConfig(config_path);
+
+		// flags override the config
+		for (auto const& [key, value] : config) {
+			params.insert({ key, value });
+		}
+	}
+
+	for (auto const& key : { "window_size", "threshold", "step_size" }) {
+		if (!params.contains(key)) {
+			std::cout << "Error, No " << key << " Given in Flags or Config" << std::endl;
+			return 1;
+		}
+	}
+
+	// no cap unless given
+	params.insert({ "max_transitions", -1 });
+
+	std::cout << "Compiling " << graphdir
+		<< " (window " << params["window_size"]
+		<< ", threshold " << params["threshold"]
+		<< ", step " << params["step_size"]
+		<< (params["max_transitions"] >= 0 ? ", max transitions " + std::to_string(params["max_transitions"]) : "")
+		<< (params["lazy_transitions"] ? ", lazy transitions" : "") << ")" << std::endl;
+
+	// ========== Compile ==========
+	if (force) {
+		std::filesystem::remove(graphdir + "graph.snapshot");
+	}
+
+	try {
+		Graph graph = Pipeline::loadGraph(params["window_size"], params["threshold"], params["step_size"], graphdir, cachedir, n_threads, params["lazy_transitions"], params["max_transitions"]);
+
+		// an updated snapshot must be the one a full rebuild writes
+		if (verify) {
+			const std::string rebuilt_path = graphdir + "graph.snapshot.rebuilt";
+			Graph rebuilt = Pipeline::genGraph(params["window_size"], params["threshold"], params["step_size"], graphdir, cachedir, n_threads, params["lazy_transitions"], params["max_transitions"]);
+			rebuilt.saveSnapshot(rebuilt_path, graph.getKey());
+
+			const bool same = sameFiles(graphdir + "graph.snapshot", rebuilt_path);
+			std::filesystem::remove(rebuilt_path);
+			if (!same) {
+				std::cout << "Error, The Snapshot Differs From a Full Rebuild" << std::endl;
+				return 1;
+			}
+			std::cout << "Snapshot Verified Against a Full Rebuild" << std::endl;
+		}
+	}
+	catch (const std::exception& e) {
+		std::cout << "Error, " << e.what() << std::endl;
+		return 1;
+	}
+
+	std::cout << "Graph Snapshot: " << graphdir << "graph.snapshot" << std::endl;
+	std::cout << "Total " << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << "s" << std::endl;
+
+	return 0;
+}
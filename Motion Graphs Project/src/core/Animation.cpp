@@ -63,7 +63,7 @@ Animation::Animation(Skeleton* _skeleton, std::string amcpath) {
                 else if (i == 2) { key = "rz"; }
 
                 // if the bone has the corresponding dof, read the data
-                if (bone->dof[key] == true) {
+                if (bone->dof.at(key) == true) {
                     data[i] = strtof(line_tokens.at(j).c_str(), NULL);
                     j++;
                 }
@@ -78,9 +78,10 @@ Animation::Animation(Skeleton* _skeleton, std::string amcpath) {
     f.close();
 }
 
-Animation::Animation(Skeleton* _skeleton, std::vector<Frame> frames) {
+Animation::Animation(Skeleton* _skeleton, std::vector<Frame> frames, const int _id) {
     skeleton = _skeleton;
     frame = frames;
+    id = _id;
 }
 
 // Use DFS down the bone hierarchy to get all vertices
@@ -231,6 +232,73 @@ void Animation::calculateFrameWithNormalisation(int frame_num, glm::mat4 startin
     calculateFrame(new_frame);
 }
 
+std::vector<float> Animation::getVerticesWithNormalisation(int frame_num, glm::mat4 starting_pos, glm::quat starting_rot) const {
+    Frame f = Frame(frame[frame_num]);
+    normaliseFrame(f, starting_pos, starting_rot);
+
+    // calculate the local transforms as in calculateFrame, but store them locally
+    std::map<const Bone*, glm::mat4> LocalTransforms;
+    for (int i = 0; i < skeleton->getBoneCount(); i++) {
+        std::string bone_name = skeleton->getBonenameByIndex(i);
+        const Bone* bone = skeleton->getBoneByName(bone_name);
+
+        auto it = f.pose.find(bone_name);
+        glm::quat rotation = it != f.pose.end() ? it->second : glm::quat();
+
+        if (bone_name == "root") {
+            LocalTransforms[bone] = f.pos * glm::toMat4(bone->Axis * rotation * bone->AxisInv);
+        }
+        else {
+            LocalTransforms[bone] = bone->parent->Offset * glm::toMat4(bone->Axis * rotation * bone->AxisInv);
+        }
+    }
+
+    // use DFS down the bone hierarchy as in getVertices
+    std::vector<float> result;
+    const Bone* root = skeleton->getBoneByName("root");
+
+    std::stack<const Bone*> sStack;
+    sStack.push(root);
+
+    while (sStack.empty() == false) {
+        const Bone* current_node = sStack.top();
+        sStack.pop();
+
+        for (int i = 0; i < current_node->children.size(); i++) {
+            sStack.push(current_node->children[i]);
+        }
+
+        if (current_node == root) {
+            continue;
+        }
+
+        // calculate the global transform as in calculateGlobalTransform
+        glm::mat4 GlobalTransform = glm::mat4(1.0f);
+        const Bone* bone = current_node;
+        while (bone->parent != NULL) {
+            GlobalTransform = LocalTransforms[bone] * GlobalTransform;
+            bone = bone->parent;
+        }
+        GlobalTransform = LocalTransforms[root] * GlobalTransform;
+
+        // calculate the coordinates as in calculateBoneCoord
+        glm::vec4 start_pos = { 0.0f, 0.0f, 0.0f, 1.0f };
+        glm::vec4 end_pos = current_node->Offset * start_pos;
+
+        start_pos = GlobalTransform * start_pos;
+        end_pos = GlobalTransform * end_pos;
+
+        result.push_back(start_pos[0]);
+        result.push_back(start_pos[1]);
+        result.push_back(start_pos[2]);
+        result.push_back(end_pos[0]);
+        result.push_back(end_pos[1]);
+        result.push_back(end_pos[2]);
+    }
+
+    return result;
+}
+
 int Animation::getID() const {
     return id;
 }
@@ -245,6 +313,11 @@ Animation::Frame Animation::getFrame(int indexID) const {
     return new_frame;
 }
 
+// get the joint rotations of a frame
+const std::map<std::string, glm::quat>& Animation::getFramePose(int indexID) const {
+    return frame.at(indexID).pose;
+}
+
 // get frame position
 glm::mat4 Animation::getFramePos(int indexID) const {
     return frame.at(indexID).pos;
@@ -11,4 +11,5 @@ Bone::Bone(BoneStruct bonedata) {
     Axis = glm::quat(glm::radians(glm::vec3(bonedata.axis[0], bonedata.axis[1], bonedata.axis[2])));
     AxisInv = glm::inverse(Axis);
     LocalTransform = glm::mat4(1.0f);
+    parent = NULL;
 }
@@ -18,6 +18,7 @@
 #include <gen/Pathline.h>
 #include <mogen/KovarMG.h>
 #include <mogen/RandomMG.h>
+#include <mogen/BeamMG.h>
 #include <mogen/MotionGenerator.h>
 
 #include <iostream>
@@ -36,7 +37,6 @@ enum Mode { PLAY_ANIMATION, PLAY_GRAPH };
 
 // function declarations
 int init();
-std::map<std::string, int> loadGraphConfig(std::string config_path);
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void cursor_position_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
@@ -45,6 +45,8 @@ void processInput(GLFWwindow* window);
 int playGraph(MotionGenerator& motionGenerator);
 int playAnimation(Animation& animation);
 void reset(bool ignorePathline = false);
+int editPoint(const glm::vec3& position);
+void trimRootline(int frames);
 
 // settings
 const int scale = 1;
@@ -56,6 +58,7 @@ const int MAX_FPS = 600.0;
 const int MIN_FPS = 1.0;
 const float CAMERA_SENSITIVITY = 0.1f;
 const float PATH_RADIUS = 1.0;          // how far away to place new point for path
+const float EDIT_RADIUS = 2.0;          // how close to the path a stroke must start to redraw it from there
 
 // playback attributes
 bool play = true;
@@ -119,6 +122,7 @@ int main(int argc, char* argv[]) {
         std::cout << "Select Graph Type" << std::endl;
         std::cout << "1. Random Graph Walk" << std::endl;
         std::cout << "2. Kovar Graph Walk (Recommended)" << std::endl;
+        std::cout << "3. Beam Graph Walk" << std::endl;
 
         std::cin >> graphType;
     }
@@ -139,8 +143,9 @@ int main(int argc, char* argv[]) {
     else if (mode == PLAY_GRAPH) {
 
         // Subject 91
-        auto config = loadGraphConfig("data/graphs/graph91/config.txt");
-        Graph graph = Pipeline::genGraph(config["window_size"], config["threshold"], config["step_size"], "data/graphs/graph91/");
+        auto config = Pipeline::loadGraphConfig("data/graphs/graph91/config.txt");
+        Graph graph = Pipeline::loadGraph(config["window_size"], config["threshold"], config["step_size"], "data/graphs/graph91/", "data/graphs/cache/", -1, config["lazy_transitions"],
+            config.contains("max_transitions") ? config["max_transitions"] : -1);
 
         if (graphType == 1) {
             RandomMG randomMG = RandomMG(&graph);
@@ -149,9 +154,15 @@ int main(int argc, char* argv[]) {
         }
         else if (graphType == 2) {
             KovarMG kovarMG = KovarMG(&graph);
+            kovarMG.setPlanCache("data/graphs/cache/plans/");
             MoGen = &kovarMG;
             playGraph(kovarMG);
         }
+        else if (graphType == 3) {
+            BeamMG beamMG = BeamMG(&graph);
+            MoGen = &beamMG;
+            playGraph(beamMG);
+        }
         else {
             std::cout << "Error, Not a Valid Mode!" << std::endl;
             abort();
@@ -445,29 +456,33 @@ int playGraph(MotionGenerator& motionGenerator) {
 
         if (play == true) {
             bool completed = false;
+            const int played = motionGenerator.getPlayedFrames();
             vertices = motionGenerator.getNextFrame(&completed);
 
             // global variable to draw rootline
             root_pos = motionGenerator.getRoot();
             
-            // push root pos into rootline
-            if (rootline.size() == 0) {
-                // initialise
+            // push root pos into rootline, once per frame played, so it can be trimmed to the frames a replan keeps
+            // a generator that holds its frame while it plans plays no frame
+            if (played == -1 || played != motionGenerator.getPlayedFrames()) {
+                if (rootline.size() == 0) {
+                    // initialise
+                    rootline.push_back(root_pos[0]);
+                    rootline.push_back(0);
+                    rootline.push_back(root_pos[2]);
+                }
+                else {
+                    // push last 3 elements onto rootline
+                    // keep in mind that rootlint.size() grows while adding elements
+                    rootline.push_back(rootline[rootline.size() - 3]);
+                    rootline.push_back(rootline[rootline.size() - 3]);
+                    rootline.push_back(rootline[rootline.size() - 3]);
+                }
+
                 rootline.push_back(root_pos[0]);
                 rootline.push_back(0);
                 rootline.push_back(root_pos[2]);
             }
-            else {
-                // push last 3 elements onto rootline
-                // keep in mind that rootlint.size() grows while adding elements
-                rootline.push_back(rootline[rootline.size() - 3]);
-                rootline.push_back(rootline[rootline.size() - 3]);
-                rootline.push_back(rootline[rootline.size() - 3]);
-            }
-
-            rootline.push_back(root_pos[0]);
-            rootline.push_back(0);
-            rootline.push_back(root_pos[2]);
 
             // clear root line if the character has completed the path
             if (completed) {
@@ -755,6 +770,8 @@ int playGraph(MotionGenerator& motionGenerator) {
             ImGui::Text("======= Draw Mode ========");
             ImGui::Text("Draw Mode      (/)");
             ImGui::Text("Draw Path      (left click)");
+            ImGui::Text("Extend Path    (shift + left click)");
+            ImGui::Text("Redraw Path    (left click on path)");
             ImGui::Text("Zoom           (scroll)");
             ImGui::Text("");
             ImGui::Text("========= Others =========");
@@ -806,10 +823,14 @@ int playGraph(MotionGenerator& motionGenerator) {
 
         // Search Path
         if (runSearch) {
-            if (isRunning) {
+            // motion generators that replan keep playing & only plan the part of the path that changed
+            if (isRunning && !MoGen->replans()) {
                 reset(true);
             }
             MoGen->setPath(pathline);
+            if (isRunning) {
+                trimRootline(MoGen->getPlayedFrames());
+            }
             isRunning = true;
             runSearch = false;
         }
@@ -910,19 +931,26 @@ void cursor_position_callback(GLFWwindow* window, double xpos, double ypos) {
         if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS) {
             auto debug = pathline.size();
 
-            // clear pathline
-            if (prev_keystates[GLFW_MOUSE_BUTTON_LEFT] == GLFW_RELEASE) {
-                reset();
-            }
-
-            prev_keystates[GLFW_MOUSE_BUTTON_LEFT] = GLFW_PRESS;
-
             // [0, 1] interval mapping: x' = x * (b - a) + a; {0 <= x <= 1}
             float x_coord = (xpos / SCR_WIDTH) * ortho_width - ortho_width / 2;
             float y_coord = ((ypos - TOOLBAR_HEIGHT) / SCR_HEIGHT) * ortho_height - ortho_height / 2;
             y_coord *= -1;  // height is from top to bottom
             x_coord *= -1;  // height is from top to bottom
 
+            // a stroke started on the path after the character redraws the path from there, shift extends it,
+            // anything else clears it
+            if (prev_keystates[GLFW_MOUSE_BUTTON_LEFT] == GLFW_RELEASE && glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) != GLFW_PRESS) {
+                const int point = editPoint(glm::vec3(x_coord, 0.0f, y_coord));
+                if (point > 0) {
+                    pathline.resize(6 * (point + 1));
+                }
+                else {
+                    reset();
+                }
+            }
+
+            prev_keystates[GLFW_MOUSE_BUTTON_LEFT] = GLFW_PRESS;
+
             // initialise
             if (pathline.empty()) {
                 // line start
@@ -1012,28 +1040,33 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
     glViewport(0, 0, width, height);
 }
 
-// Load Graph Configuration File
-std::map<std::string, int> loadGraphConfig(std::string config_path) {
-
-    std::ifstream f(config_path);
-    
-    // check if file is opened successfully
-    if (!f.is_open()) {
-        perror(("error while opening file " + config_path).c_str());
-        abort();
+// Point of the pathline closest to the position within EDIT_RADIUS, after the last frame played, 0 if there is none
+// The points are the ends of the line segments, the first at the root, and are PATH_RADIUS apart along the path
+int editPoint(const glm::vec3& position) {
+    const int first = std::floor(MoGen->getPlayedArclength() / PATH_RADIUS) + 1;
+
+    int point = 0;
+    float closest = EDIT_RADIUS;
+    for (int i = first; 6 * i + 6 <= (int)pathline.size(); i++) {
+        const glm::vec3 P = glm::vec3(pathline[6 * i + 3], pathline[6 * i + 4], pathline[6 * i + 5]);
+        const float distance = glm::distance(P, position);
+        if (distance < closest) {
+            closest = distance;
+            point = i;
+        }
     }
+    return point;
+}
 
-    // fill up config map
-    std::map<std::string, int> config;
-    std::string line;
-    while (getline(f, line)) {
-        std::vector<std::string> line_tokens;
-        boost::split(line_tokens, line, [](char c) {return c == ' '; });
-
-        config[line_tokens[0]] = std::stoi(line_tokens[1]);
+// keep the rootline of the first frames played, the frames a replan keeps, a line segment per frame
+void trimRootline(int frames) {
+    if (frames == -1) {
+        return;
+    }
+    const size_t size = 6 * frames;
+    if (rootline.size() > size) {
+        rootline.resize(size);
     }
-
-    return config;
 }
 
 // reset the state for motion graph
@@ -0,0 +1,194 @@
+#include <core/Scheduler.h>
+
+Scheduler::Scheduler(const int _n_threads) {
+	n_threads = _n_threads;
+
+	if (n_threads <= 0) {
+		n_threads = std::max(1, (int)std::thread::hardware_concurrency());
+	}
+}
+
+int Scheduler::addTask(const std::string stage, std::function<void()> function, const std::vector<int>& dependencies) {
+
+	// get the stage, add it if it does not exist
+	int stageID = -1;
+	for (int i = 0; i < (int)stages.size(); i++) {
+		if (stages[i].name == stage) {
+			stageID = i;
+		}
+	}
+	if (stageID == -1) {
+		Stage newStage;
+		newStage.name = stage;
+		stages.push_back(newStage);
+		stageID = stages.size() - 1;
+	}
+
+	Task task;
+	task.stage = stageID;
+	task.function = function;
+
+	const int taskID = tasks.size();
+	for (const int dependency : dependencies) {
+		if (dependency < 0) {
+			continue;
+		}
+
+		assert(dependency < taskID);
+		tasks[dependency].dependents.push_back(taskID);
+		task.n_dependencies++;
+	}
+
+	tasks.push_back(task);
+	stages[stageID].n_tasks++;
+
+	return taskID;
+}
+
+void Scheduler::run() {
+	start = std::chrono::steady_clock::now();
+	n_remaining = tasks.size();
+
+	// queue all tasks without dependencies
+	for (int i = 0; i < (int)tasks.size(); i++) {
+		if (tasks[i].n_dependencies == 0) {
+			push(i);
+		}
+	}
+
+	// start the workers and wait for all tasks to complete
+	std::vector<std::thread> threads;
+	for (int i = 0; i < n_threads; i++) {
+		threads.push_back(std::thread(&Scheduler::worker, this));
+	}
+
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	wall = elapsed();
+
+	if (exception) {
+		std::exception_ptr error = exception;
+		exception = nullptr;
+		std::rethrow_exception(error);
+	}
+}
+
+// must be called with the mutex held
+void Scheduler::push(int taskID) {
+	Stage& stage = stages[tasks[taskID].stage];
+	stage.queued++;
+	stage.maxQueued = std::max(stage.maxQueued, stage.queued);
+
+	ready.push(std::make_pair(tasks[taskID].stage, -taskID));
+}
+
+void Scheduler::worker() {
+	while (true) {
+		int taskID;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [&]() { return !ready.empty() || n_remaining == 0; });
+
+			// all tasks are done
+			if (ready.empty()) {
+				return;
+			}
+
+			taskID = -ready.top().second;
+			ready.pop();
+
+			// sample the queue depth
+			Stage& stage = stages[tasks[taskID].stage];
+			stage.sumQueued += stage.queued;
+			stage.queued--;
+			if (stage.firstStart < 0) {
+				stage.firstStart = elapsed();
+			}
+		}
+
+		// run the task
+		const double taskStart = elapsed();
+		std::exception_ptr error;
+		try {
+			tasks[taskID].function();
+		}
+		catch (...) {
+			error = std::current_exception();
+		}
+		const double taskEnd = elapsed();
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+
+			Stage& stage = stages[tasks[taskID].stage];
+			stage.busy += taskEnd - taskStart;
+			stage.lastEnd = std::max(stage.lastEnd, taskEnd);
+
+			// a failed task stops the run, the tasks still running finish but no other task starts
+			if (error && !exception) {
+				exception = error;
+			}
+			if (exception) {
+				ready = std::priority_queue<std::pair<int, int>>();
+				n_remaining = 0;
+			}
+			else {
+				// release the dependents
+				for (const int dependent : tasks[taskID].dependents) {
+					tasks[dependent].n_dependencies--;
+					if (tasks[dependent].n_dependencies == 0) {
+						push(dependent);
+					}
+				}
+
+				n_remaining--;
+			}
+		}
+		condition.notify_all();
+	}
+}
+
+double Scheduler::elapsed() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Scheduler::printMetrics() {
+	std::cout << "Scheduler: " << tasks.size() << " tasks on " << n_threads << " threads in " << wall << "s" << std::endl;
+	std::cout << std::left
+		<< std::setw(14) << "stage"
+		<< std::setw(8) << "tasks"
+		<< std::setw(12) << "max queue"
+		<< std::setw(12) << "avg queue"
+		<< std::setw(12) << "busy (s)"
+		<< std::setw(14) << "active (s)"
+		<< std::setw(12) << "util (%)" << std::endl;
+
+	double totalBusy = 0.0;
+	for (const auto& stage : stages) {
+		totalBusy += stage.busy;
+
+		// utilisation of all threads while the stage was active
+		const double active = stage.firstStart < 0 ? 0.0 : stage.lastEnd - stage.firstStart;
+		const double utilisation = active > 0 ? 100.0 * stage.busy / (active * n_threads) : 0.0;
+
+		std::cout << std::left
+			<< std::setw(14) << stage.name
+			<< std::setw(8) << stage.n_tasks
+			<< std::setw(12) << stage.maxQueued
+			<< std::setw(12) << (stage.n_tasks > 0 ? stage.sumQueued / stage.n_tasks : 0.0)
+			<< std::setw(12) << stage.busy
+			<< std::setw(14) << active
+			<< std::setw(12) << utilisation << std::endl;
+	}
+
+	if (wall > 0) {
+		std::cout << "Overall Utilisation: " << 100.0 * totalBusy / (wall * n_threads) << "%" << std::endl;
+	}
+	std::cout << std::right;
+}
+
+int Scheduler::getThreadCount() {
+	return n_threads;
+}
@@ -2,19 +2,38 @@
 
 Skeleton::Skeleton(std::string filepath) {
 
-
-    // ========== Parse the asf file ==========
-
     // open file
-    std::string data;
     std::ifstream f(filepath);
-    std::string line;
 
     if (!f.is_open()) {
         perror(("Error while opening file " + filepath).c_str());
         abort();
     }
 
+    // keep the source so the skeleton can be stored with the graph
+    std::stringstream ss;
+    ss << f.rdbuf();
+    source = ss.str();
+    f.close();
+
+    parse(source);
+}
+
+Skeleton::Skeleton(std::istream& stream) {
+    std::stringstream ss;
+    ss << stream.rdbuf();
+    source = ss.str();
+
+    parse(source);
+}
+
+void Skeleton::parse(const std::string asf) {
+
+    // ========== Parse the asf file ==========
+
+    std::stringstream f(asf);
+    std::string line;
+
     std::vector<std::string> bonedata = {};             // each line correspoding to a bone
     std::vector<std::vector<std::string>> hierarchy;    // the hierarchy of bones
 
@@ -125,9 +144,6 @@ Skeleton::Skeleton(std::string filepath) {
             }
         }
     }
-
-    // Close the file
-    f.close();
 }
 
 // Clear out data a bone struct
@@ -167,3 +183,7 @@ std::string Skeleton::getBonenameByIndex(int index) const {
 
 
 
+
+const std::string& Skeleton::getSource() const {
+    return source;
+}
@@ -36,6 +36,65 @@ std::vector<std::vector<float>> Distance::distance(const int STEP_SIZE) {
 	return result;
 }
 
+std::vector<Distance::PointCloud> Distance::pointClouds(const Animation* A, const int SIZE, const int STEP_SIZE) {
+
+	std::vector<PointCloud> result;
+
+	int A_size = A->getFrameSize();
+
+	for (int ai = 0; ai < A_size - (SIZE - 1); ai += STEP_SIZE) {
+
+		PointCloud cloud;
+
+		auto root_pos = A->getFramePos(ai);
+		auto root_rot = A->getFrameRot(ai);
+
+		for (int frame_id = ai; frame_id < ai + SIZE; frame_id++) {
+			std::vector<float> vertices = A->getVerticesWithNormalisation(frame_id, root_pos, root_rot);
+
+			for (int i = 3; i < vertices.size(); i += 2 * 3) {
+				cloud.x.push_back(vertices[i + 0]);
+				cloud.y.push_back(vertices[i + 1]);
+				cloud.z.push_back(vertices[i + 2]);
+			}
+		}
+
+		result.push_back(cloud);
+	}
+
+	return result;
+}
+
+std::vector<std::vector<float>> Distance::distance(const std::vector<PointCloud>& clouds1, const std::vector<PointCloud>& clouds2) {
+
+	std::vector<std::vector<float>> result(clouds1.size(), std::vector<float>(clouds2.size()));
+
+	for (int ai = 0; ai < clouds1.size(); ai++) {
+		for (int bi = 0; bi < clouds2.size(); bi++) {
+			result[ai][bi] = distanceOfClouds(clouds1[ai], clouds2[bi]);
+		}
+	}
+
+	return result;
+}
+
+// same metric as distanceOfClip
+float Distance::distanceOfClouds(const PointCloud& cloud1, const PointCloud& cloud2) {
+
+	float sumOfSquaredDistance = 0.0;
+	for (int i = 0; i < cloud1.x.size(); i++) {
+		float x = cloud1.x[i] - cloud2.x[i];
+		float y = cloud1.y[i] - cloud2.y[i];
+		float z = cloud1.z[i] - cloud2.z[i];
+
+		float squaredDistance = pow(x, 2) + pow(y, 2) + pow(y, 2);
+
+		sumOfSquaredDistance += squaredDistance;
+	}
+
+	return sumOfSquaredDistance;
+}
+
 float Distance::distanceOfClip(Clip C1, Clip C2) {
 	
 	std::map<char, std::vector<float>> cloud1, cloud2;
@@ -0,0 +1,144 @@
+#include <gen/DistanceCache.h>
+
+DistanceCache::DistanceCache(const std::string _cachedir, const long long _quota) : index(_cachedir, ".dist", _quota) {
+}
+
+std::uint64_t DistanceCache::fnv1a(const char* data, size_t size, std::uint64_t hash) {
+	for (size_t i = 0; i < size; i++) {
+		hash ^= (unsigned char)data[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+std::string DistanceCache::toHex(std::uint64_t hash) {
+	std::stringstream ss;
+	ss << std::hex << std::setw(16) << std::setfill('0') << hash;
+	return ss.str();
+}
+
+std::string DistanceCache::hashFile(const std::string filepath) {
+	std::ifstream infile(filepath, std::ios::binary);
+
+	if (!infile.is_open()) {
+		perror(("error while opening file " + filepath).c_str());
+		abort();
+	}
+
+	// hash the file in chunks
+	std::uint64_t hash = 14695981039346656037ULL;
+	std::vector<char> buffer(1 << 16);
+	while (infile.read(buffer.data(), buffer.size()) || infile.gcount() > 0) {
+		hash = fnv1a(buffer.data(), infile.gcount(), hash);
+	}
+
+	return toHex(hash);
+}
+
+std::string DistanceCache::hashString(const std::string data) {
+	return toHex(fnv1a(data.c_str(), data.size()));
+}
+
+std::string DistanceCache::makeKey(const std::string amc_hash1, const std::string amc_hash2, const std::string asf_hash, const int WINDOW_SIZE, const int STEP_SIZE) {
+	// all inputs that affect the matrix go into the key
+	std::string description = "v" + std::to_string(Distance::VERSION)
+		+ "_" + amc_hash1
+		+ "_" + amc_hash2
+		+ "_" + asf_hash
+		+ "_w" + std::to_string(WINDOW_SIZE)
+		+ "_s" + std::to_string(STEP_SIZE);
+
+	return toHex(fnv1a(description.c_str(), description.size()));
+}
+
+bool DistanceCache::contains(const std::string key) {
+	return index.contains(key) && std::filesystem::exists(index.entryPath(key));
+}
+
+bool DistanceCache::load(const std::string key, std::vector<std::vector<float>>& distance) {
+
+	// mark as recently used, the index is written with the next store or when the cache is closed
+	long long size = 0;
+	if (!index.touch(key, size)) {
+		return false;
+	}
+
+	// the file may be evicted by a store of another thread or process while it is read, which is a miss
+	if (!loadDistanceFromFile(index.entryPath(key), size, distance)) {
+		index.missing(key);
+		return false;
+	}
+
+	return true;
+}
+
+void DistanceCache::store(const std::string key, const std::vector<std::vector<float>>& distance) {
+
+	// write to a temporary file first so an interrupted write or a reader never sees a partial matrix
+	const std::string temp_path = index.entryPath(key) + ".tmp";
+	saveDistanceToFile(distance, temp_path);
+	index.add(key, temp_path);
+}
+
+void DistanceCache::saveDistanceToFile(const std::vector<std::vector<float>>& distance, std::string filename) {
+	std::ofstream DistanceCSV(filename);
+
+	// enough digits that a matrix loaded from the cache is the matrix that was generated, so a graph built from cached
+	// matrices is the same as one built from generated matrices
+	DistanceCSV << std::setprecision(std::numeric_limits<float>::max_digits10);
+	for (size_t i = 0; i < distance.size(); i++) {
+		for (size_t j = 0; j < distance[0].size(); j++) {
+			DistanceCSV << distance[i][j] << " ";
+		}
+		DistanceCSV << "\n";
+	}
+	DistanceCSV.close();
+}
+
+// Read a matrix written by saveDistanceToFile. Returns false if the file is missing, is not size bytes long, or is
+// not a rectangular matrix of numbers
+bool DistanceCache::loadDistanceFromFile(std::string filename, long long size, std::vector<std::vector<float>>& distance) {
+
+	std::ifstream infile(filename);
+
+	if (!infile.is_open()) {
+		return false;
+	}
+
+	std::stringstream contents;
+	contents << infile.rdbuf();
+	if ((long long)contents.str().size() != size) {
+		return false;
+	}
+
+	std::vector<std::vector<float>> result;
+
+	for (std::string line; getline(contents, line); )
+	{
+		std::vector<float> tokens;
+
+		std::stringstream ss(line);
+		std::string word;
+		while (ss >> word) {
+			try {
+				tokens.push_back(std::stof(word));
+			}
+			catch (const std::logic_error&) {
+				return false;
+			}
+		}
+
+		if (tokens.empty() || (!result.empty() && tokens.size() != result[0].size())) {
+			return false;
+		}
+
+		result.push_back(tokens);
+	}
+
+	if (result.empty()) {
+		return false;
+	}
+
+	distance = std::move(result);
+	return true;
+}
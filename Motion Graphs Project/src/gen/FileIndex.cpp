@@ -0,0 +1,232 @@
+#include <gen/FileIndex.h>
+
+FileIndex::FileIndex(const std::string _cachedir, const std::string _extension, const long long _quota) {
+	cachedir = _cachedir;
+	extension = _extension;
+	quota = _quota;
+
+	// create the cache directory if it does not exist
+	std::filesystem::create_directories(cachedir);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	lockFile();
+	index = loadIndex();
+	adoptOrphans();
+	unlockFile();
+}
+
+FileIndex::~FileIndex() {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!touched.empty() || !dropped.empty()) {
+		lockFile();
+		sync();
+		saveIndex();
+		unlockFile();
+	}
+}
+
+std::string FileIndex::entryPath(const std::string key) const {
+	return cachedir + key + extension;
+}
+
+bool FileIndex::contains(const std::string key) {
+	std::lock_guard<std::mutex> lock(mutex);
+	return index.contains(key);
+}
+
+bool FileIndex::touch(const std::string key, long long& size) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (!index.contains(key)) {
+		return false;
+	}
+
+	index[key].lastUsed = std::time(nullptr);
+	touched[key] = index[key].lastUsed;
+	size = index[key].size;
+	return true;
+}
+
+void FileIndex::missing(const std::string key) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!std::filesystem::exists(entryPath(key))) {
+		index.erase(key);
+		touched.erase(key);
+		dropped.insert(key);
+	}
+}
+
+bool FileIndex::add(const std::string key, const std::string temp_path) {
+	std::lock_guard<std::mutex> lock(mutex);
+	lockFile();
+	sync();
+
+	// the file is moved in under the lock, so another process never sees it without its entry
+	std::error_code error;
+	std::filesystem::rename(temp_path, entryPath(key), error);
+	const long long size = error ? 0 : std::filesystem::file_size(entryPath(key), error);
+
+	if (error) {
+		std::cout << "Error in Caching " << entryPath(key) << ", " << error.message() << std::endl;
+		std::filesystem::remove(temp_path, error);
+	}
+	else {
+		Entry entry;
+		entry.size = size;
+		entry.lastUsed = std::time(nullptr);
+		index[key] = entry;
+	}
+
+	// keep the cache under quota
+	evict(key);
+	saveIndex();
+	unlockFile();
+
+	return !error;
+}
+
+std::string FileIndex::indexPath() const {
+	return cachedir + "index.txt";
+}
+
+std::string FileIndex::lockPath() const {
+	return cachedir + "index.lock";
+}
+
+// take the lock file, waiting for another process to release it. A lock older than LOCK_TIMEOUT is broken
+// if the lock file cannot be created at all (e.g. a read only cache) the index is used without it
+void FileIndex::lockFile() {
+	while (true) {
+		if (std::FILE* file = std::fopen(lockPath().c_str(), "wx")) {
+			std::fclose(file);
+			locked = true;
+			return;
+		}
+
+		std::error_code error;
+		const auto time = std::filesystem::last_write_time(lockPath(), error);
+		if (error) {
+			// the lock file is not there, it could not be created
+			if (!std::filesystem::exists(lockPath(), error)) {
+				locked = false;
+				return;
+			}
+		}
+		else if (std::filesystem::file_time_type::clock::now() - time > LOCK_TIMEOUT) {
+			std::cout << "Breaking Stale Lock " << lockPath() << std::endl;
+			std::filesystem::remove(lockPath(), error);
+		}
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+void FileIndex::unlockFile() {
+	if (locked) {
+		std::error_code error;
+		std::filesystem::remove(lockPath(), error);
+		locked = false;
+	}
+}
+
+std::map<std::string, FileIndex::Entry> FileIndex::loadIndex() {
+	std::map<std::string, Entry> result;
+	std::ifstream infile(indexPath());
+
+	// no index yet, start with an empty cache
+	if (!infile.is_open()) {
+		return result;
+	}
+
+	// each line is [KEY] [SIZE] [LAST_USED]
+	for (std::string line; getline(infile, line); ) {
+		std::stringstream ss(line);
+		std::string key;
+		Entry entry;
+
+		if (ss >> key >> entry.size >> entry.lastUsed) {
+			result[key] = entry;
+		}
+	}
+
+	return result;
+}
+
+void FileIndex::saveIndex() {
+	std::ofstream outfile(indexPath());
+	for (auto const& [key, entry] : index) {
+		outfile << key << " " << entry.size << " " << entry.lastUsed << "\n";
+	}
+	outfile.close();
+}
+
+// index the entry files that are not in index.txt, e.g. of a process that died before writing it, as least recently
+// used so they are the first to be evicted
+void FileIndex::adoptOrphans() {
+	std::error_code error;
+	bool adopted = false;
+	for (auto const& file : std::filesystem::directory_iterator(cachedir, error)) {
+		const std::string key = file.path().stem().string();
+		if (file.path().extension() != extension || index.contains(key)) {
+			continue;
+		}
+
+		Entry entry;
+		entry.size = file.file_size(error);
+		if (!error) {
+			index[key] = entry;
+			adopted = true;
+		}
+	}
+
+	if (adopted) {
+		evict("");
+		saveIndex();
+	}
+}
+
+// reload index.txt, which other processes may have changed, & apply the hits & drops of this process since the last sync
+// entries that another process evicted stay evicted, their hits are dropped. The lock file must be held
+void FileIndex::sync() {
+	index = loadIndex();
+
+	for (auto const& key : dropped) {
+		index.erase(key);
+	}
+	for (auto const& [key, lastUsed] : touched) {
+		if (index.contains(key)) {
+			index[key].lastUsed = std::max(index[key].lastUsed, lastUsed);
+		}
+	}
+
+	touched.clear();
+	dropped.clear();
+}
+
+// evict least recently used entries until the cache is under quota. The entry "keep" is never evicted
+void FileIndex::evict(const std::string keep) {
+	long long total = 0;
+	for (auto const& [key, entry] : index) {
+		total += entry.size;
+	}
+
+	while (total > quota) {
+		auto lru = index.end();
+		for (auto it = index.begin(); it != index.end(); it++) {
+			if (it->first != keep && (lru == index.end() || it->second.lastUsed < lru->second.lastUsed)) {
+				lru = it;
+			}
+		}
+
+		// nothing left to evict
+		if (lru == index.end()) {
+			break;
+		}
+
+		std::cout << "Evicting " << entryPath(lru->first) << std::endl;
+		std::error_code error;
+		std::filesystem::remove(entryPath(lru->first), error);	// may fail while another thread reads it
+		total -= lru->second.size;
+		index.erase(lru);
+	}
+}
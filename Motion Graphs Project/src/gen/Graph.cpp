@@ -1,35 +1,475 @@
-#include <gen/graph.h>
+#include <gen/Graph.h>
 
-Graph::Graph(Skeleton* _skeleton, std::vector<Animation*>& animations, std::vector<std::tuple<std::tuple<int, int>, std::tuple<int, int>>>& _edges, const int _window_size) {
+Graph::Graph(Skeleton* _skeleton, std::vector<Animation*>& animations, std::vector<Transition>& _edges, const int _window_size, const bool _lazyTransitions, const int _n_threads, const int _max_transitions) {
 
 	// set skeleton
 	skeleton = _skeleton;
 	window_size = _window_size;
+	lazyTransitions = _lazyTransitions;
+	n_threads = _n_threads;
+	maxTransitions = _max_transitions;
+	if (window_size > MAX_ALPHA) {
+		throw std::runtime_error("Window size " + std::to_string(window_size) + " does not fit in a FrameID");
+	}
+	transitionCache = std::make_shared<LRUCache<FrameID, Animation::Frame>>(TRANSITION_CACHE_SIZE);
 
 	// load animations
 	for (int i = 0; i < animations.size(); i++) {
-		anim_database[animations[i]->getID()] = animations[i];
+		addAnimation(animations[i]);
 	}
 
-	// generate empty frame mat
-	for (auto const& [animID, anim] : anim_database) {
-		for (int j = 0; j < anim->getFrameSize(); j++) {
-			FrameID newFrameID;
-			FrameVec newFrameVec;
+	// load transitional edges
+	transitions = _edges;
+
+	build();
+}
+
+void Graph::update(std::vector<Animation*>& addedAnimations, std::vector<int>& removedAnimations, std::vector<Transition>& addedEdges) {
+
+	// the graph no longer matches the inputs of its key
+	key.clear();
+
+	// remove animations with their frames and transitions
+	for (const int animID : removedAnimations) {
+		removeAnimation(animID);
+	}
+
+	// add new animations
+	for (int i = 0; i < addedAnimations.size(); i++) {
+		addAnimation(addedAnimations[i]);
+	}
+
+	// add the transitions of the new animation pairs, in the order of a full rebuild: by animation pair, and as
+	// generated within a pair
+	transitions.insert(transitions.end(), addedEdges.begin(), addedEdges.end());
+	std::stable_sort(transitions.begin(), transitions.end(), [](const Transition& a, const Transition& b) {
+		return std::make_tuple(get<0>(get<0>(a)), get<0>(get<1>(a))) < std::make_tuple(get<0>(get<0>(b)), get<0>(get<1>(b)));
+	});
 
-			newFrameID.animID = anim->getID();
-			newFrameID.indexID = j;
+	// rebuild the nodes, only blending & posing frames that are new
+	build();
+}
+
+// ========== Snapshot ==========
+// [MAGIC] [VERSION] [KEY] [PAYLOAD SIZE] [PAYLOAD]
+// the payload holds the window size, the lazy transitions flag, the transition cap, the settings key, the asf source, the animations with
+// their hashes, the unpruned transitions and every frame in FrameMat, so no frames of lazy transitions
+// all values are written in native byte order, poses store bone indices of the skeleton instead of bone names
+
+static const char SNAPSHOT_MAGIC[8] = { 'M', 'G', 'S', 'N', 'A', 'P', '\0', '\0' };
+
+struct SnapshotWriter {
+	std::string buffer;
+
+	template <typename T>
+	void put(const T value) {
+		buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
 
-			FrameMat[newFrameID] = newFrameVec;
+	void putString(const std::string& value) {
+		put<std::uint32_t>(value.size());
+		buffer.append(value);
+	}
+};
+
+struct SnapshotReader {
+	const char* data;
+	size_t size;
+	size_t pos = 0;
+
+	template <typename T>
+	T get() {
+		if (pos + sizeof(T) > size) {
+			throw std::runtime_error("Snapshot is truncated");
 		}
+		T value;
+		std::memcpy(&value, data + pos, sizeof(T));
+		pos += sizeof(T);
+		return value;
 	}
 
-	// load transitional edges
-	for (auto undirectedEdge : _edges) {
+	std::string getString() {
+		const std::uint32_t length = get<std::uint32_t>();
+		if (pos + length > size) {
+			throw std::runtime_error("Snapshot is truncated");
+		}
+		std::string value(data + pos, length);
+		pos += length;
+		return value;
+	}
+};
+
+static void writeFrameID(SnapshotWriter& writer, const Graph::FrameID& frameID) {
+	writer.put<std::int32_t>(frameID.animID);
+	writer.put<std::int32_t>(frameID.indexID);
+	writer.put<std::int32_t>(frameID.animID2);
+	writer.put<std::int32_t>(frameID.indexID2);
+	writer.put<std::int32_t>(frameID.alpha);
+	writer.put<std::uint8_t>(frameID.tMode);
+}
+
+static Graph::FrameID readFrameID(SnapshotReader& reader) {
+	Graph::FrameID frameID;
+	frameID.animID = reader.get<std::int32_t>();
+	frameID.indexID = reader.get<std::int32_t>();
+	frameID.animID2 = reader.get<std::int32_t>();
+	frameID.indexID2 = reader.get<std::int32_t>();
+	frameID.alpha = reader.get<std::int32_t>();
+	frameID.tMode = reader.get<std::uint8_t>();
+	return frameID;
+}
+
+static void writePose(SnapshotWriter& writer, const Animation::Frame& frame, const std::map<std::string, std::uint16_t>& boneIndex) {
+	writer.put(frame.pos);
+	writer.put<std::uint32_t>(frame.pose.size());
+	for (auto const& [bone_name, rotation] : frame.pose) {
+		writer.put<std::uint16_t>(boneIndex.at(bone_name));
+		writer.put(rotation);
+	}
+}
+
+static Animation::Frame readPose(SnapshotReader& reader, const std::vector<std::string>& bonenames) {
+	Animation::Frame frame;
+	frame.pos = reader.get<glm::mat4>();
+	const std::uint32_t n_bones = reader.get<std::uint32_t>();
+	for (std::uint32_t i = 0; i < n_bones; i++) {
+		const std::uint16_t index = reader.get<std::uint16_t>();
+		if (index >= bonenames.size()) {
+			throw std::runtime_error("Snapshot has an unknown bone");
+		}
+		frame.pose.emplace_hint(frame.pose.end(), bonenames[index], reader.get<glm::quat>());
+	}
+	return frame;
+}
+
+static const size_t SNAPSHOT_HEADER_SIZE = sizeof(SNAPSHOT_MAGIC) + sizeof(std::int32_t) + sizeof(std::uint32_t);
+
+void Graph::saveSnapshot(const std::string snapshot_path, const std::string key) const {
+
+	std::vector<std::string> bonenames = skeleton->getBonenames();
+	std::map<std::string, std::uint16_t> boneIndex;
+	for (int i = 0; i < bonenames.size(); i++) {
+		boneIndex[bonenames[i]] = i;
+	}
+
+	SnapshotWriter payload;
+	payload.put<std::int32_t>(window_size);
+	payload.put<std::uint8_t>(lazyTransitions);
+	payload.put<std::int32_t>(maxTransitions);
+	payload.putString(settingsKey);
+	payload.putString(skeleton->getSource());
+
+	// animations
+	payload.put<std::uint32_t>(anim_database.size());
+	for (auto const& [animID, animation] : anim_database) {
+		auto hash = animHashes.find(animID);
+		payload.put<std::int32_t>(animID);
+		payload.putString(hash != animHashes.end() ? hash->second : "");
+		payload.put<std::uint32_t>(animation->getFrameSize());
+		for (int i = 0; i < animation->getFrameSize(); i++) {
+			writePose(payload, animation->getFrame(i), boneIndex);
+		}
+	}
+
+	// unpruned transitions
+	payload.put<std::uint32_t>(transitions.size());
+	for (auto const& [from, to, cost] : transitions) {
+		payload.put<std::int32_t>(std::get<0>(from));
+		payload.put<std::int32_t>(std::get<1>(from));
+		payload.put<std::int32_t>(std::get<0>(to));
+		payload.put<std::int32_t>(std::get<1>(to));
+		payload.put<float>(cost);
+	}
+
+	// nodes in order
+	payload.put<std::uint32_t>(FrameMat.size());
+	for (auto const& [frameID, frameVec] : FrameMat) {
+		writeFrameID(payload, frameID);
+		payload.put<std::uint8_t>(frameVec.isStartNode);
+		payload.put<std::uint8_t>(frameVec.isEndNode);
+		writeFrameID(payload, frameVec.seqEdge);
+		payload.put<float>(frameVec.arclen);
+		payload.put(frameVec.truePos);
+		writePose(payload, frameVec.pose, boneIndex);
+
+		payload.put<std::uint32_t>(frameVec.edges.size());
+		for (auto const& edge : frameVec.edges) {
+			auto cost = frameVec.edgeCosts.find(edge);
+			writeFrameID(payload, edge);
+			payload.put<float>(cost != frameVec.edgeCosts.end() ? cost->second : -1.0f);
+		}
+
+		payload.put<std::uint32_t>(frameVec.directEdges.size());
+		for (auto const& edge : frameVec.directEdges) {
+			writeFrameID(payload, edge);
+		}
+	}
+
+	SnapshotWriter header;
+	header.buffer.append(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+	header.put<std::int32_t>(SNAPSHOT_VERSION);
+	header.putString(key);
+	header.put<std::uint64_t>(payload.buffer.size());
+
+	// write to a temporary file first so an interrupted write never leaves a snapshot that looks complete
+	const std::string temp_path = snapshot_path + ".tmp";
+	std::ofstream outfile(temp_path, std::ios::binary);
+
+	if (!outfile.is_open()) {
+		throw std::runtime_error("Error in Writing to File " + temp_path);
+	}
+
+	outfile.write(header.buffer.data(), header.buffer.size());
+	outfile.write(payload.buffer.data(), payload.buffer.size());
+	outfile.close();
+
+	std::filesystem::rename(temp_path, snapshot_path);
+}
+
+bool Graph::isSnapshotCurrent(const std::string snapshot_path, const std::string key) {
+	std::ifstream infile(snapshot_path, std::ios::binary);
+
+	if (!infile.is_open()) {
+		return false;
+	}
+
+	// only the header is read
+	std::vector<char> header(SNAPSHOT_HEADER_SIZE + key.size() + sizeof(std::uint64_t));
+	if (!infile.read(header.data(), header.size())) {
+		return false;
+	}
+
+	try {
+		SnapshotReader reader{ header.data(), header.size() };
+		reader.pos = sizeof(SNAPSHOT_MAGIC);
+		if (std::memcmp(header.data(), SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0
+			|| reader.get<std::int32_t>() != SNAPSHOT_VERSION
+			|| reader.getString() != key) {
+			return false;
+		}
+
+		// the file must hold the whole payload
+		const std::uint64_t payload_size = reader.get<std::uint64_t>();
+		return std::filesystem::file_size(snapshot_path) == header.size() + payload_size;
+	}
+	catch (const std::runtime_error&) {
+		// the header was written with a key of a different length
+		return false;
+	}
+}
+
+const std::string& Graph::getKey() const {
+	return key;
+}
+
+void Graph::setKey(const std::string _key) {
+	key = _key;
+}
+
+void Graph::setSources(const std::string _settingsKey, const std::map<int, std::string>& _animHashes) {
+	settingsKey = _settingsKey;
+	animHashes = _animHashes;
+}
+
+const std::string& Graph::getSettingsKey() const {
+	return settingsKey;
+}
+
+const std::map<int, std::string>& Graph::getAnimationHashes() const {
+	return animHashes;
+}
+
+Graph::Graph(const std::string snapshot_path) {
+
+	// read the whole snapshot in one go
+	std::ifstream infile(snapshot_path, std::ios::binary);
+
+	if (!infile.is_open()) {
+		throw std::runtime_error("Error while opening file " + snapshot_path);
+	}
+
+	std::vector<char> buffer(std::filesystem::file_size(snapshot_path));
+	infile.read(buffer.data(), buffer.size());
+	infile.close();
+
+	SnapshotReader reader{ buffer.data(), buffer.size() };
+
+	// header
+	if (buffer.size() < sizeof(SNAPSHOT_MAGIC) || std::memcmp(buffer.data(), SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+		throw std::runtime_error(snapshot_path + " is not a graph snapshot");
+	}
+	reader.pos = sizeof(SNAPSHOT_MAGIC);
+
+	if (reader.get<std::int32_t>() != SNAPSHOT_VERSION) {
+		throw std::runtime_error(snapshot_path + " has an unsupported snapshot version");
+	}
+	key = reader.getString();
+	const std::uint64_t payload_size = reader.get<std::uint64_t>();
+	if (reader.pos + payload_size != buffer.size()) {
+		throw std::runtime_error("Snapshot is truncated");
+	}
+
+	// skeleton
+	window_size = reader.get<std::int32_t>();
+	lazyTransitions = reader.get<std::uint8_t>();
+	maxTransitions = reader.get<std::int32_t>();
+	transitionCache = std::make_shared<LRUCache<FrameID, Animation::Frame>>(TRANSITION_CACHE_SIZE);
+	settingsKey = reader.getString();
+	std::stringstream asf(reader.getString());
+	skeleton = new Skeleton(asf);
+	const std::vector<std::string> bonenames = skeleton->getBonenames();
+
+	// animations
+	const std::uint32_t n_animations = reader.get<std::uint32_t>();
+	for (std::uint32_t i = 0; i < n_animations; i++) {
+		const int animID = reader.get<std::int32_t>();
+		const std::string hash = reader.getString();
+		const std::uint32_t n_frames = reader.get<std::uint32_t>();
+
+		std::vector<Animation::Frame> frames;
+		frames.reserve(n_frames);
+		for (std::uint32_t j = 0; j < n_frames; j++) {
+			frames.push_back(readPose(reader, bonenames));
+		}
+
+		// the frames of the animation are part of the nodes below
+		anim_database[animID] = new Animation(skeleton, frames, animID);
+		if (!hash.empty()) {
+			animHashes[animID] = hash;
+		}
+	}
+
+	// unpruned transitions
+	const std::uint32_t n_transitions = reader.get<std::uint32_t>();
+	transitions.reserve(n_transitions);
+	for (std::uint32_t i = 0; i < n_transitions; i++) {
+		const int animID1 = reader.get<std::int32_t>();
+		const int indexID1 = reader.get<std::int32_t>();
+		const int animID2 = reader.get<std::int32_t>();
+		const int indexID2 = reader.get<std::int32_t>();
+		const float cost = reader.get<float>();
+		transitions.push_back(std::make_tuple(std::make_tuple(animID1, indexID1), std::make_tuple(animID2, indexID2), cost));
+	}
+
+	// nodes are stored in order, so every insert goes to the end of the map
+	const std::uint32_t n_frames = reader.get<std::uint32_t>();
+	for (std::uint32_t i = 0; i < n_frames; i++) {
+		const FrameID frameID = readFrameID(reader);
+
+		FrameVec frameVec;
+		frameVec.isStartNode = reader.get<std::uint8_t>();
+		frameVec.isEndNode = reader.get<std::uint8_t>();
+		frameVec.seqEdge = readFrameID(reader);
+		frameVec.arclen = reader.get<float>();
+		frameVec.truePos = reader.get<glm::vec3>();
+		frameVec.pose = readPose(reader, bonenames);
+
+		const std::uint32_t n_edges = reader.get<std::uint32_t>();
+		for (std::uint32_t j = 0; j < n_edges; j++) {
+			const FrameID edge = readFrameID(reader);
+			const float cost = reader.get<float>();
+			frameVec.edges.emplace_hint(frameVec.edges.end(), edge);
+
+			// sequential edges have no cost entry
+			if (cost >= 0.0f) {
+				frameVec.edgeCosts.emplace_hint(frameVec.edgeCosts.end(), edge, cost);
+			}
+		}
+
+		const std::uint32_t n_directEdges = reader.get<std::uint32_t>();
+		for (std::uint32_t j = 0; j < n_directEdges; j++) {
+			frameVec.directEdges.emplace_hint(frameVec.directEdges.end(), readFrameID(reader));
+		}
+
+		FrameMat.emplace_hint(FrameMat.end(), frameID, std::move(frameVec));
+	}
+
+	compile();
+
+	std::cout << "Loaded Graph Snapshot " << snapshot_path << " (" << getNodeCount() << " frames)" << std::endl;
+}
+
+void Graph::addAnimation(Animation* animation) {
+	// the frame ids are packed, see FrameID
+	if (animation->getID() < 0 || animation->getID() > MAX_ANIM_ID || animation->getFrameSize() > MAX_INDEX_ID) {
+		throw std::runtime_error("Animation " + std::to_string(animation->getID()) + " does not fit in a FrameID");
+	}
+
+	anim_database[animation->getID()] = animation;
+
+	// generate empty frames
+	for (int j = 0; j < animation->getFrameSize(); j++) {
+		FrameID newFrameID;
+		FrameVec newFrameVec;
+
+		newFrameID.animID = animation->getID();
+		newFrameID.indexID = j;
+
+		FrameMat[newFrameID] = newFrameVec;
+	}
+}
+
+void Graph::removeAnimation(int animID) {
+	auto animation = anim_database.find(animID);
+	if (animation != anim_database.end()) {
+		delete animation->second;
+		anim_database.erase(animation);
+	}
+	animHashes.erase(animID);
+
+	// remove all frames & transition frames of the animation
+	std::erase_if(FrameMat, [&](const auto& item) {
+		return item.first.animID == animID || (item.first.tMode && item.first.animID2 == animID);
+	});
+
+	// remove all transitions of the animation
+	std::erase_if(transitions, [&](const auto& edge) {
+		return get<0>(get<0>(edge)) == animID || get<0>(get<1>(edge)) == animID;
+	});
+}
+
+// print the distribution of the number of transitions per frame
+static void printDegrees(const std::string label, std::vector<int> degrees) {
+	if (degrees.empty()) {
+		std::cout << label << ": no frames" << std::endl;
+		return;
+	}
+
+	std::sort(degrees.begin(), degrees.end());
+	auto percentile = [&](const float p) { return degrees[std::min(degrees.size() - 1, (size_t)(degrees.size() * p))]; };
+	const double total = std::accumulate(degrees.begin(), degrees.end(), 0.0);
+
+	std::cout << label << ": " << degrees.size() << " frames"
+		<< ", min " << degrees.front()
+		<< ", mean " << total / degrees.size()
+		<< ", p50 " << percentile(0.5f)
+		<< ", p90 " << percentile(0.9f)
+		<< ", p99 " << percentile(0.99f)
+		<< ", max " << degrees.back() << std::endl;
+}
+
+// (re)builds the graph from anim_database & transitions
+// poses, arclens and blended transition frames that already exist are kept, so an incremental update only computes the new ones
+void Graph::build() {
+
+	// reset the nodes & edges of all frames
+	for (auto& [frameID, frameVec] : FrameMat) {
+		frameVec.isStartNode = false;
+		frameVec.isEndNode = false;
+		frameVec.edges.clear();
+		frameVec.edgeCosts.clear();
+		frameVec.directEdges.clear();
+		frameVec.seqEdge = FrameID();
+	}
+
+	// collect the transitions leaving each frame, keeping the cheapest of duplicates
+	std::map<FrameID, std::map<FrameID, float>> candidates;
+	for (auto undirectedEdge : transitions) {
 		std::array<std::tuple<std::tuple<int, int>, std::tuple<int, int>>, 2> directedEdges;
 
 		directedEdges[0] = std::make_tuple(get<0>(undirectedEdge), get<1>(undirectedEdge));
 		directedEdges[1] = std::make_tuple(get<1>(undirectedEdge), get<0>(undirectedEdge));
+		const float cost = get<2>(undirectedEdge);
 
 		for (auto edge : directedEdges) {
 
@@ -47,6 +487,31 @@ Graph::Graph(Skeleton* _skeleton, std::vector<Animation*>& animations, std::vect
 
 			node2.indexID += window_size;
 
+			auto [it, inserted] = candidates[node1].try_emplace(node2, cost);
+			if (!inserted) {
+				it->second = std::min(it->second, cost);
+			}
+		}
+	}
+
+	std::vector<int> degrees;
+	for (auto const& [node1, targets] : candidates) {
+		degrees.push_back(targets.size());
+	}
+	printDegrees("Transition Out-Degree", degrees);
+
+	// load transitional edges, only the max_transitions cheapest of each frame with a cap
+	for (auto const& [node1, targets] : candidates) {
+		std::vector<std::pair<float, FrameID>> ordered;
+		for (auto const& [node2, cost] : targets) {
+			ordered.push_back(std::make_pair(cost, node2));
+		}
+		std::sort(ordered.begin(), ordered.end());
+		if (maxTransitions >= 0 && ordered.size() > (size_t)maxTransitions) {
+			ordered.resize(maxTransitions);
+		}
+
+		for (auto const& [cost, node2] : ordered) {
 			FrameVec& frameVec1 = FrameMat[node1];
 			FrameVec& frameVec2 = FrameMat[node2];
 
@@ -55,9 +520,8 @@ Graph::Graph(Skeleton* _skeleton, std::vector<Animation*>& animations, std::vect
 			frameVec2.isEndNode = true;
 
 			// add frame1 -> frame2
-			if (!frameVec1.edges.contains(node2)) {
-				frameVec1.edges.insert(node2);
-			}
+			frameVec1.edges.insert(node2);
+			frameVec1.edgeCosts[node2] = cost;
 		}
 	}
 
@@ -69,6 +533,11 @@ Graph::Graph(Skeleton* _skeleton, std::vector<Animation*>& animations, std::vect
 		int animID = frameID.animID;
 		int indexID = frameID.indexID;
 
+		// transition frames are not nodes
+		if (frameID.tMode) {
+			continue;
+		}
+
 		// load animation to prev_nodes
 		if (!prev_nodes.contains(animID)) {
 			prev_nodes[animID] = -1;
@@ -94,11 +563,20 @@ Graph::Graph(Skeleton* _skeleton, std::vector<Animation*>& animations, std::vect
 	// prune the graph
 	pruneGraph();
 
+	// the cap may leave frames that only had expensive transitions out of the SCC
+	degrees.clear();
+	for (auto const& [frameID, frameVec] : FrameMat) {
+		if (frameVec.isStartNode) {
+			degrees.push_back(frameVec.edgeCosts.size());
+		}
+	}
+	printDegrees(maxTransitions >= 0 ? "Pruned Out-Degree (cap " + std::to_string(maxTransitions) + ")" : "Pruned Out-Degree", degrees);
+
 	// connect each frame to the next direct frame
 	bool connect = false;
 	for (auto const& [frameID, frameVec] : FrameMat) {
 
-		if (isTerminalNode(frameID)) {
+		if (frameID.tMode || isTerminalNode(frameID)) {
 			continue;
 		}
 
@@ -111,24 +589,31 @@ Graph::Graph(Skeleton* _skeleton, std::vector<Animation*>& animations, std::vect
 	}
 
 	// generate transitions
+	// lazy transitions only link their first frame, their frames are not in FrameMat but blended by compile
+	std::set<FrameID> transitionFrames;
+	std::vector<std::pair<FrameID, FrameID>> transitionEdges;
 	for (auto const& [frameID, frameVec] : FrameMat) {
+		if (frameID.tMode) {
+			continue;
+		}
+
 		for (auto const& nextFrameID : FrameMat[frameID].edges) {
 			if (isNode(frameID) && FrameMat[frameID].seqEdge != nextFrameID) {		// if it is a transition edge
+				if (lazyTransitions) {
+					FrameMat[frameID].directEdges.insert(transitionFrame(frameID, nextFrameID, 1));
+					continue;
+				}
+				transitionEdges.push_back(std::make_pair(frameID, nextFrameID));
+
 				FrameID prevFrameID = frameID;
 				for (int i = 1; i < window_size; i++) {
-					FrameID tFrameID;
-					FrameVec tFrameVec;
-
-					// set up transition frame
-					tFrameID.animID = frameID.animID;
-					tFrameID.indexID = frameID.indexID + i;
-					tFrameID.animID2 = nextFrameID.animID;
-					tFrameID.indexID2 = nextFrameID.indexID - window_size + i;
-					tFrameID.tMode = true;
-					tFrameID.alpha = i;
+					const FrameID tFrameID = transitionFrame(frameID, nextFrameID, i);
 
-					// insert transition frame
-					FrameMat[tFrameID] = tFrameVec;
+					// insert transition frame, keeping it if it was already blended
+					if (!FrameMat.contains(tFrameID)) {
+						FrameMat[tFrameID] = FrameVec();
+					}
+					transitionFrames.insert(tFrameID);
 
 					// connect to previous frame
 					FrameMat[prevFrameID].directEdges.insert(tFrameID);
@@ -146,68 +631,126 @@ Graph::Graph(Skeleton* _skeleton, std::vector<Animation*>& animations, std::vect
 		}
 	}
 
-	// generate the pose & arclen all nodes
-	FrameID prevFrameID;
-	for (auto const& [frameID, frameVec] : FrameMat) {
-		if (!frameID.tMode) {	// sequential nodes
-			// get pose
-			auto pose = anim_database[frameID.animID]->getFrame(frameID.indexID);
+	// remove transition frames of transitions that no longer exist
+	std::erase_if(FrameMat, [&](const auto& item) {
+		return item.first.tMode && !transitionFrames.contains(item.first);
+	});
+
+	// generate the pose & arclen of all frames that do not have one yet
+	// the animations are posed in parallel and each transition is blended once the animations on both ends are posed.
+	// Every frame is written by exactly one task, so the result does not depend on the order the tasks run in
+	Scheduler scheduler(n_threads);
+	std::map<int, int> poseTasks;
+	for (auto const& [animID, animation] : anim_database) {
+		poseTasks[animID] = scheduler.addTask("pose", [this, animID]() { poseAnimation(animID); });
+	}
+	for (auto const& [node, nextNode] : transitionEdges) {
+		scheduler.addTask("blend", [this, node, nextNode]() { blendTransition(node, nextNode); },
+			{ poseTasks[node.animID], poseTasks[nextNode.animID] });
+	}
+	scheduler.run();
+	scheduler.printMetrics();
 
-			// normalize frame relative to previous frame
-			if (prevFrameID.animID != -1 && prevFrameID.animID == frameID.animID) {
-				Animation::Frame prevFrame = anim_database[prevFrameID.animID]->getFrame(prevFrameID.indexID);
-				Animation::normaliseFrame(pose, prevFrame.pos, prevFrame.pose["root"]);
+	// compile the array representation used by the search
+	compile();
 
-				const auto distance = glm::distance(glm::vec3(pose.pos[3][0], 0.0f, pose.pos[3][2]), glm::vec3(0.0f));
-				FrameMat[frameID].arclen = FrameMat[prevFrameID].arclen + std::max(distance, SMALL_INCREMENT);
-				FrameMat[frameID].truePos = FrameMat[prevFrameID].truePos + glm::vec3(pose.pos[3]);
-			}
-			
-			FrameMat[frameID].pose = pose;
-			prevFrameID = frameID;
-		}
-		else {	// transitional nodes
-			const auto pose = blend(frameID, window_size);
-			FrameMat[frameID].pose = pose;
-
-			if (frameID.alpha == 1) {
-				const auto distance = glm::distance(glm::vec3(pose.pos[3][0], 0.0f, pose.pos[3][2]), glm::vec3(0.0f));
-				FrameMat[frameID].arclen = std::max(distance, SMALL_INCREMENT);
-				FrameMat[frameID].truePos = glm::vec3(pose.pos[3]);
-			}
-			else if (frameID.alpha > 1) {
-				prevFrameID.animID = frameID.animID;
-				prevFrameID.indexID = frameID.indexID - 1;
-				prevFrameID.animID2 = frameID.animID2;
-				prevFrameID.indexID2 = frameID.indexID2 - 1;
-				prevFrameID.alpha = frameID.alpha - 1;
-				prevFrameID.tMode = frameID.tMode;
-
-				const auto distance = glm::distance(glm::vec3(pose.pos[3][0], 0.0f, pose.pos[3][2]), glm::vec3(0.0f));
-				FrameMat[frameID].arclen = FrameMat[prevFrameID].arclen + std::max(distance, SMALL_INCREMENT);
-				FrameMat[frameID].truePos = FrameMat[prevFrameID].truePos + glm::vec3(pose.pos[3]);
-			}
-			else {
-				throw new std::exception("Fatal Error, Invalid Alpha");
-			}
-		}
-	}
+	// blended poses of removed transitions must not be returned
+	transitionCache->clear();
 
 	// print graph
 	std::cout << "Saving & Printing Graph" << std::endl;
 	toFile(true);
 	std::cout << "End Printing Graph" << std::endl;
 
-	const auto& n_edges = _edges.size();
-	const auto& n_frames = FrameMat.size();
-	const auto& avg_edge_length = (FrameMat.size() / n_edges);
+	const auto& n_edges = transitions.size();
+	const auto& n_frames = getNodeCount();
+	const auto& avg_edge_length = (getNodeCount() / n_edges);
 
 	std::cout << "Number of Edges: " << n_edges << std::endl;
 	std::cout << "Number of Frames: " << n_frames << std::endl;
 	std::cout << "Avg Edge Length: " << avg_edge_length << std::endl;
 }
 
-Animation::Frame Graph::blend(FrameID transID, int windowSize) {
+// pose the frames of an animation relative to their previous frame and integrate the arclength
+// only reads other frames, so animations can be posed concurrently
+void Graph::poseAnimation(int animID) {
+	const Animation* animation = anim_database.at(animID);
+
+	const FrameVec* prevFrameVec = NULL;
+	for (int indexID = 0; indexID < animation->getFrameSize(); indexID++) {
+		FrameVec& frameVec = FrameMat.at(getFrameID(animID, indexID));
+
+		// only the root relative to the previous frame is kept, the joint rotations are read from the animation
+		if (frameVec.pose.pose.empty()) {
+			glm::mat4 pos = animation->getFramePos(indexID);
+			glm::quat rot = animation->getFrameRot(indexID);
+
+			// normalize frame relative to previous frame
+			if (prevFrameVec) {
+				Animation::normaliseTransform(pos, rot, animation->getFramePos(indexID - 1), animation->getFrameRot(indexID - 1));
+
+				const auto distance = glm::distance(glm::vec3(pos[3][0], 0.0f, pos[3][2]), glm::vec3(0.0f));
+				frameVec.arclen = prevFrameVec->arclen + std::max(distance, SMALL_INCREMENT);
+				frameVec.truePos = prevFrameVec->truePos + glm::vec3(pos[3]);
+			}
+
+			frameVec.pose.pos = pos;
+			frameVec.pose.pose["root"] = rot;
+		}
+
+		prevFrameVec = &frameVec;
+	}
+}
+
+// blend the frames of the transition node -> nextNode and integrate the arclength
+// only reads the sequential frames, so transitions can be blended concurrently once both animations are posed
+void Graph::blendTransition(FrameID node, FrameID nextNode) {
+
+	const FrameVec* prevFrameVec = NULL;
+	for (int i = 1; i < window_size; i++) {
+		const FrameID tFrameID = transitionFrame(node, nextNode, i);
+		FrameVec& frameVec = FrameMat.at(tFrameID);
+
+		if (frameVec.pose.pose.empty()) {
+			blendFrame(tFrameID, prevFrameVec, frameVec);
+		}
+
+		prevFrameVec = &frameVec;
+	}
+}
+
+// blend the pose of a transition frame & integrate the arclength from the previous frame of the transition
+// only the root is kept with lazy transitions
+void Graph::blendFrame(FrameID tFrameID, const FrameVec* prevFrameVec, FrameVec& frameVec) const {
+	const auto pose = blend(tFrameID, window_size, lazyTransitions);
+	const auto distance = glm::distance(glm::vec3(pose.pos[3][0], 0.0f, pose.pos[3][2]), glm::vec3(0.0f));
+
+	if (prevFrameVec) {
+		frameVec.arclen = prevFrameVec->arclen + std::max(distance, SMALL_INCREMENT);
+		frameVec.truePos = prevFrameVec->truePos + glm::vec3(pose.pos[3]);
+	}
+	else {
+		frameVec.arclen = std::max(distance, SMALL_INCREMENT);
+		frameVec.truePos = glm::vec3(pose.pos[3]);
+	}
+
+	frameVec.pose = pose;
+}
+
+// frame alpha of the transition node -> nextNode
+Graph::FrameID Graph::transitionFrame(FrameID node, FrameID nextNode, int alpha) const {
+	FrameID tFrameID;
+	tFrameID.animID = node.animID;
+	tFrameID.indexID = node.indexID + alpha;
+	tFrameID.animID2 = nextNode.animID;
+	tFrameID.indexID2 = nextNode.indexID - window_size + alpha;
+	tFrameID.tMode = true;
+	tFrameID.alpha = alpha;
+	return tFrameID;
+}
+
+// rootOnly only interpolates the root position & rotation
+Animation::Frame Graph::blend(FrameID transID, int windowSize, bool rootOnly) const {
 
 	// to convert "amount" to [0,1] and ensure C1 continuity
 	auto interpolate = [](int amount, int windowSize) {
@@ -222,30 +765,36 @@ Animation::Frame Graph::blend(FrameID transID, int windowSize) {
 	};
 
 	Animation::Frame output;
-	Animation::Frame frame1 = getFrameVec(transID.animID, transID.indexID).pose;
-	Animation::Frame frame2 = getFrameVec(transID.animID2, transID.indexID2).pose;
+	const Animation::Frame& root1 = getFrameVec(transID.animID, transID.indexID).pose;
+	const Animation::Frame& root2 = getFrameVec(transID.animID2, transID.indexID2).pose;
 
 	// get interpolation value
 	float ap = interpolate(transID.alpha, windowSize);
 
 	// interpolate the root1 & root2
-	glm::mat4 root1 = frame1.pos;
-	glm::mat4 root2 = frame2.pos;
-	glm::mat4 root = ap * root1 + (1 - ap) * root2;
+	glm::mat4 root = ap * root1.pos + (1 - ap) * root2.pos;
 	output.pos = root;
 
-	// interpolate the joint angles
+	// interpolate the root rotation
+	output.pose["root"] = glm::mix(root1.pose.at("root"), root2.pose.at("root"), 1 - ap);
+	if (rootOnly) {
+		return output;
+	}
+
+	// interpolate the joint angles, which the graph reads from the animations
+	const auto& pose1 = anim_database.at(transID.animID)->getFramePose(transID.indexID);
+	const auto& pose2 = anim_database.at(transID.animID2)->getFramePose(transID.indexID2);
 	for (std::string bone : skeleton->getBonenames()) {
 
 		// skip if bone is not in motion
 		// this can happen as lhipjoint and rhipjoint may not be specified / rotated at all
-		if (!frame1.pose.contains(bone) || !frame2.pose.contains(bone)) {
+		if (bone == "root" || !pose1.contains(bone) || !pose2.contains(bone)) {
 			continue;
 		}
 
 		// initialise the quartenions
-		glm::quat quat1 = frame1.pose.at(bone);
-		glm::quat quat2 = frame2.pose.at(bone);
+		glm::quat quat1 = pose1.at(bone);
+		glm::quat quat2 = pose2.at(bone);
 
 		// interpolate
 		glm::quat quat;
@@ -258,217 +807,179 @@ Animation::Frame Graph::blend(FrameID transID, int windowSize) {
 }
 
 
-// uses Tarjan's algorithm to generate strongly connected components
-// adapted from https://en.wikipedia.org/wiki/Tarjan%27s_strongly_connected_components_algorithm
+// keeps only the largest strongly connected component, so every node can be left & reached again
+// the nodes are numbered densely and the components found on CSR arrays, iterative Tarjan for normal graphs &
+// parallel forward-backward for very large ones (see SCC.h). Neither recurses, so millions of nodes do not overflow the stack
 void Graph::pruneGraph() {
 
-	// define vertex struct for algorithm
-	struct Vertex {
-		FrameID frameID;
-		int index = -1;
-		int lowlink = -1;
-		bool onStack = false;
-	};
-
-	// generate set of vertices
-	std::map<FrameID, Vertex> vertices;
+	// number the nodes in FrameMat order
+	std::vector<FrameID> nodes;
 	for (auto const& [frameID, frameVec] : FrameMat) {
 		if (isNode(frameID)) {
-			Vertex v;
-			v.frameID = frameID;
-			vertices[v.frameID] = v;
+			nodes.push_back(frameID);
 		}
 	}
+	const int N = nodes.size();
 
-	int index = 0;	// to give nodes unique indexes
-	std::stack<Vertex> stack;
-	std::map<int, std::set<FrameID>> SCCs;
-
-	// define lambda function for strong connect
-	std::function<void(Vertex&)> strongConnect;
-	strongConnect = [&](Vertex& v) -> void {
-		// setup
-		v.index = index;
-		v.lowlink = index;
-		v.onStack = true;
-		stack.push(v);
-		index++;
-
-		std::set<FrameID>& edges = FrameMat[v.frameID].edges;
-		for (auto const& w_id : edges) {
-
-			Vertex& w = vertices[w_id];
+	// FrameMat is sorted, so are the nodes
+	auto nodeIndex = [&](const FrameID& frameID) -> int {
+		auto it = std::lower_bound(nodes.begin(), nodes.end(), frameID);
+		return (it != nodes.end() && *it == frameID) ? (int)(it - nodes.begin()) : -1;
+	};
 
-			if (w.index == -1) {
-				strongConnect(w);
-				v.lowlink = std::min(v.lowlink, w.lowlink);
-			}
-			else if (w.onStack) {
-				v.lowlink = std::min(v.lowlink, w.index);
+	std::vector<int> offsets(N + 1, 0);
+	std::vector<int> targets;
+	for (int v = 0; v < N; v++) {
+		for (auto const& w_id : FrameMat[nodes[v]].edges) {
+			const int w = nodeIndex(w_id);
+			if (w != -1) {
+				targets.push_back(w);
 			}
 		}
+		offsets[v + 1] = targets.size();
+	}
 
-		Vertex u;
-		if (v.lowlink == v.index) {
-			std::set<FrameID> set;
-
-			do {
-				u = stack.top();
-				stack.pop();
-
-				u.onStack = false;
-				set.insert(u.frameID);
-			} while (u.index != v.index);
-
-			SCCs[v.index] = set;
-		}
-	};
+	std::vector<int> components = (N >= SCC::PARALLEL_THRESHOLD && n_threads != 1)
+		? SCC::forwardBackward(offsets, targets, n_threads)
+		: SCC::tarjan(offsets, targets);
 
-	for (std::map<FrameID, Vertex>::iterator it = vertices.begin(); it != vertices.end(); it++) {
-		if (it->second.index == -1) {
-			strongConnect(it->second);
-		}
+	// membership of the largest SCC
+	const int largestSCC = SCC::largest(components);
+	std::vector<bool> inSCC(N, false);
+	for (int v = 0; v < N; v++) {
+		inSCC[v] = components[v] == largestSCC;
 	}
 
 	// start pruning
-	// get largest SCC
-	int largestSCC = 0;
-	for (auto it = SCCs.begin(); it != SCCs.end(); it++) {
-		if (it->second.size() > SCCs[largestSCC].size()) {
-			largestSCC = it->first;
-		}
-	}
-
 	// remove all edges that do not connect two nodes in the SCC
-	for (auto const& [frameID, vertex] : vertices) {
-
-		// copy edges as you cannot delete elements from the same set while looping
-		std::set<FrameID> edges = std::set<FrameID>(FrameMat[frameID].edges);
-		for (auto it = edges.begin(); it != edges.end(); it++) {
-			if (!SCCs[largestSCC].contains(frameID) || !SCCs[largestSCC].contains(*it)) {
-				FrameMat[frameID].edges.erase(*it);
-				if (FrameMat[frameID].seqEdge == *it) {		// unset sequential edges as well
-					FrameMat[frameID].seqEdge.animID = -1;
-				}
+	for (int v = 0; v < N; v++) {
+		FrameVec& frameVec = FrameMat[nodes[v]];
+
+		std::erase_if(frameVec.edges, [&](const FrameID& w_id) {
+			const int w = nodeIndex(w_id);
+			if (inSCC[v] && w != -1 && inSCC[w]) {
+				return false;
 			}
-		}
+			if (frameVec.seqEdge == w_id) {		// unset sequential edges as well
+				frameVec.seqEdge.animID = -1;
+			}
+			frameVec.edgeCosts.erase(w_id);
+			return true;
+		});
 	}
 
 	// remove all nodes without edges
-	for (auto const& [frameID, vertex] : vertices) {
-		if (FrameMat[frameID].edges.size() == 0) {
-			FrameMat[frameID].isStartNode = false;
-			FrameMat[frameID].isEndNode = false;
+	for (int v = 0; v < N; v++) {
+		if (FrameMat[nodes[v]].edges.size() == 0) {
+			FrameMat[nodes[v]].isStartNode = false;
+			FrameMat[nodes[v]].isEndNode = false;
 		}
 	}
 }
 
-float Graph::dFrameArclength(FrameID currFrame, FrameID nextFrame) {
-
-	assert(
-		(currFrame.animID == nextFrame.animID
-			&& currFrame.indexID + 1 == nextFrame.indexID)
-		|| currFrame.tMode
-		|| nextFrame.tMode);
-
-	float arclen = -1.0;
-	if (currFrame.tMode == nextFrame.tMode) {
-		arclen = FrameMat[nextFrame].arclen - FrameMat[currFrame].arclen;
-	}
-	else if (!currFrame.tMode && nextFrame.tMode) {
-		arclen = FrameMat[nextFrame].arclen;
-	}
-	else if (currFrame.tMode && !nextFrame.tMode) {
-		FrameID currSeqFrame;
-		currSeqFrame.animID = currFrame.animID2;
-		currSeqFrame.indexID = currFrame.indexID2;
-
-		arclen = FrameMat[nextFrame].arclen - FrameMat[currSeqFrame].arclen;
-	}
-
-	assert(arclen >= 0);
-	return arclen;
+// the frames of lazy transitions are only in the compiled graph, so the FrameID versions look up the nodes
+float Graph::dFrameArclength(FrameID currFrame, FrameID nextFrame) const {
+	return dFrameArclength(getNodeID(currFrame), getNodeID(nextFrame));
 }
 
-float Graph::dEdgeArclength(FrameID currFrame, FrameID nextFrame) {
-	assert(isNode(currFrame) && isNode(nextFrame));
-
-	float arclen = -1.0;
-	if (FrameMat.at(currFrame).seqEdge == nextFrame) {
-		arclen = FrameMat[nextFrame].arclen - FrameMat[currFrame].arclen;
-	}
-	else {
-		arclen = FrameMat[nextFrame].arclen;
-	}
-
-	assert(arclen >= 0);
-	return arclen;
+float Graph::dEdgeArclength(FrameID currFrame, FrameID nextFrame) const {
+	return dEdgeArclength(getNodeID(currFrame), getNodeID(nextFrame));
 }
 
-glm::vec3 Graph::dEdgePosition(FrameID currFrame, FrameID nextFrame) {
+glm::vec3 Graph::dEdgePosition(FrameID currFrame, FrameID nextFrame) const {
+	return dEdgePosition(getNodeID(currFrame), getNodeID(nextFrame));
+}
 
-	assert(isNode(currFrame) && isNode(nextFrame));
+// get a copy of the frame
+Animation::Frame Graph::getFrame(FrameID frameID) const {
 
-	if (FrameMat.at(currFrame).seqEdge == nextFrame) {
-		return FrameMat[nextFrame].truePos - FrameMat[currFrame].truePos;
+	// sequential frames store only their root, the joint rotations come from the animation
+	if (!frameID.tMode) {
+		const FrameVec& frameVec = FrameMat.at(frameID);
+		Animation::Frame pose;
+		pose.pose = anim_database.at(frameID.animID)->getFramePose(frameID.indexID);
+		pose.pos = frameVec.pose.pos;
+		pose.pose["root"] = frameVec.pose.pose.at("root");
+		return pose;
 	}
-	else {
-		return FrameMat[nextFrame].truePos;
+
+	if (!lazyTransitions) {
+		return FrameMat.at(frameID).pose;
 	}
-}
 
-// get a copy of the frame
-Animation::Frame Graph::getFrame(FrameID frameID) {
-	return FrameMat[frameID].pose;
+	// blend lazy transitions on demand
+	Animation::Frame pose;
+	if (!transitionCache->get(frameID, pose)) {
+		pose = blend(frameID, window_size);
+		transitionCache->put(frameID, pose);
+	}
+	return pose;
 }
 
-glm::mat4 Graph::getRealPos(FrameID frameID) {
+glm::mat4 Graph::getRealPos(FrameID frameID) const {
 	assert(!frameID.tMode);
-	return anim_database[frameID.animID]->getFrame(frameID.indexID).pos;
+	return anim_database.at(frameID.animID)->getFrame(frameID.indexID).pos;
 }
 
-Graph::FrameID Graph::getFirstNode() {
+Graph::FrameID Graph::getFirstNode() const {
 	for (auto const& [frameID, frameVec] : FrameMat) {
 		if (isNode(frameID)) {
 			return frameID;
 		}
 	}
-	throw new std::exception("Warning: No Node Found!");
+	throw std::runtime_error("Warning: No Node Found!");
 }
 
-Animation* Graph::getAnimation(int animation_id) {
-	return anim_database[animation_id];
+Animation* Graph::getAnimation(int animation_id) const {
+	auto it = anim_database.find(animation_id);
+	return it != anim_database.end() ? it->second : NULL;
 }
 
-int Graph::getWindowSize() {
+int Graph::getWindowSize() const {
 	return window_size;
 }
 
-Animation* Graph::getRandomAnimation() {
+bool Graph::hasLazyTransitions() const {
+	return lazyTransitions;
+}
+
+int Graph::getMaxTransitions() const {
+	return maxTransitions;
+}
+
+std::vector<int> Graph::getAnimationIDs() const {
+	std::vector<int> ids;
+	for (auto const& [animID, anim] : anim_database) {
+		ids.push_back(animID);
+	}
+	return ids;
+}
+
+Animation* Graph::getRandomAnimation() const {
 	return anim_database.begin()->second;
 }
 
-std::set<Graph::FrameID> Graph::getEdges(int animID, int indexID) {
+const std::set<Graph::FrameID>& Graph::getEdges(int animID, int indexID) const {
 	return getFrameVec(animID, indexID).edges;
 }
 
-std::set<Graph::FrameID> Graph::getEdges(FrameID frameID) {
-	return FrameMat[frameID].edges;
+const std::set<Graph::FrameID>& Graph::getEdges(FrameID frameID) const {
+	return FrameMat.at(frameID).edges;
 }
 
-Graph::FrameID Graph::getFrameID(int animID, int indexID) {
+Graph::FrameID Graph::getFrameID(int animID, int indexID) const {
 	FrameID frameID;
 	frameID.animID = animID;
 	frameID.indexID = indexID;
 	return frameID;
 }
 
-const Graph::FrameVec& Graph::getFrameVec(FrameID frameID) {
+const Graph::FrameVec& Graph::getFrameVec(FrameID frameID) const {
 	assert(FrameMat.contains(frameID));
 	return FrameMat.at(frameID);
 }
 
-const Graph::FrameVec& Graph::getFrameVec(int animID, int indexID) {
+const Graph::FrameVec& Graph::getFrameVec(int animID, int indexID) const {
 	FrameID key;
 	key.animID = animID;
 	key.indexID = indexID;
@@ -476,19 +987,24 @@ const Graph::FrameVec& Graph::getFrameVec(int animID, int indexID) {
 	return getFrameVec(key);
 }
 
-Skeleton* Graph::getSkeleton() {
+Skeleton* Graph::getSkeleton() const {
 	return skeleton;
 }
 
-bool Graph::isTerminalNode(int animID, int indexID) {
+bool Graph::isTerminalNode(int animID, int indexID) const {
 	FrameID frameID = getFrameID(animID, indexID);
 
 	return isTerminalNode(frameID);
 }
 
-bool Graph::isTerminalNode(FrameID frameID) {
+bool Graph::isTerminalNode(FrameID frameID) const {
 
-	if ((FrameMat[frameID].isStartNode || FrameMat[frameID].isEndNode) && FrameMat[frameID].seqEdge.animID == -1) {
+	auto it = FrameMat.find(frameID);
+	if (it == FrameMat.end()) {
+		return false;
+	}
+
+	if ((it->second.isStartNode || it->second.isEndNode) && it->second.seqEdge.animID == -1) {
 		// return true if there is no sequential edges
 		return true;
 	}
@@ -497,8 +1013,381 @@ bool Graph::isTerminalNode(FrameID frameID) {
 	}
 }
 
+// ========== Compiled Graph ==========
+
+void Graph::compile() {
+
+	// lazy transitions are only in the compiled graph, their frames are listed & their roots blended here
+	// The list is sorted like FrameMat and follows its frames, as transition frames order after all sequential frames
+	std::vector<std::pair<FrameID, FrameVec>> lazyFrames;
+	if (lazyTransitions) {
+		for (auto const& [frameID, frameVec] : FrameMat) {
+			for (auto const& edge : frameVec.edges) {
+				if (frameVec.seqEdge == edge) {
+					continue;
+				}
+
+				for (int i = 1; i < window_size; i++) {
+					const FrameID tFrameID = transitionFrame(frameID, edge, i);
+					FrameVec tFrameVec;
+					blendFrame(tFrameID, i > 1 ? &lazyFrames.back().second : NULL, tFrameVec);
+					tFrameVec.directEdges.insert(i + 1 < window_size ? transitionFrame(frameID, edge, i + 1) : edge);
+					lazyFrames.emplace_back(tFrameID, std::move(tFrameVec));
+				}
+			}
+		}
+		std::sort(lazyFrames.begin(), lazyFrames.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+	}
+
+	const int N = FrameMat.size() + lazyFrames.size();
+
+	nodeFrameIDs.clear();
+	animOffsets.clear();
+	animFrameCounts.clear();
+	edgeOffsets.clear();
+	edgeTargets.clear();
+	edgeSuccessors.clear();
+	edgeCosts.clear();
+	directOffsets.clear();
+	directTargets.clear();
+	edgeMotions.clear();
+	frameMotions.clear();
+	sampleOffsets.clear();
+	segmentSamples.clear();
+	nodeSeqEdges.clear();
+	nodeArclens.clear();
+	nodeTruePos.clear();
+	nodeRootPos.clear();
+	nodeRootRot.clear();
+	nodeFlags.clear();
+
+	// number the frames in FrameMat order. Sequential frames come first and the frames of an animation are
+	// contiguous, so (animID, indexID) maps to a NodeID with an offset table
+	nodeFrameIDs.reserve(N);
+	auto numberFrame = [&](const FrameID& frameID) {
+		if (!frameID.tMode) {
+			if (frameID.animID >= (int)animOffsets.size()) {
+				animOffsets.resize(frameID.animID + 1, -1);
+				animFrameCounts.resize(frameID.animID + 1, 0);
+			}
+			if (animOffsets[frameID.animID] == -1) {
+				animOffsets[frameID.animID] = nodeFrameIDs.size();
+			}
+			animFrameCounts[frameID.animID]++;
+		}
+		nodeFrameIDs.push_back(frameID);
+	};
+	for (auto const& [frameID, frameVec] : FrameMat) {
+		numberFrame(frameID);
+	}
+	for (auto const& [frameID, frameVec] : lazyFrames) {
+		numberFrame(frameID);
+	}
+
+	// translate the node data & adjacency
+	edgeOffsets.reserve(N + 1);
+	directOffsets.reserve(N + 1);
+	nodeSeqEdges.reserve(N);
+	nodeArclens.reserve(N);
+	nodeTruePos.reserve(N);
+	nodeRootPos.reserve(N);
+	nodeRootRot.reserve(N);
+	nodeFlags.reserve(N);
+
+	auto compileFrame = [&](const FrameID& frameID, const FrameVec& frameVec) {
+		std::uint8_t flags = 0;
+		flags |= frameVec.isStartNode ? START_NODE : 0;
+		flags |= frameVec.isEndNode ? END_NODE : 0;
+		flags |= frameID.tMode ? TRANSITION : 0;
+		nodeFlags.push_back(flags);
+
+		nodeSeqEdges.push_back(frameVec.seqEdge.animID == -1 ? -1 : getNodeID(frameVec.seqEdge));
+		nodeArclens.push_back(frameVec.arclen);
+		nodeTruePos.push_back(frameVec.truePos);
+		nodeRootPos.push_back(frameVec.pose.pos);
+
+		const auto root = frameVec.pose.pose.find("root");
+		nodeRootRot.push_back(root != frameVec.pose.pose.end() ? root->second : glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+
+		// order the edges by cost, the sequential edge first and the transitions cheapest first
+		std::vector<std::tuple<bool, float, FrameID>> ordered;
+		for (auto const& edge : frameVec.edges) {
+			auto cost = frameVec.edgeCosts.find(edge);
+			if (frameVec.seqEdge == edge || cost == frameVec.edgeCosts.end()) {
+				ordered.push_back(std::make_tuple(false, 0.0f, edge));
+			}
+			else {
+				ordered.push_back(std::make_tuple(true, cost->second, edge));
+			}
+		}
+		std::sort(ordered.begin(), ordered.end());
+
+		// the successor of an edge is the frame following the node along it: the next frame of the animation for the
+		// sequential edge and the first frame of the blend for a transition
+		edgeOffsets.push_back(edgeTargets.size());
+		for (auto const& [transition, cost, edge] : ordered) {
+			FrameID successor;
+			if (frameVec.seqEdge == edge) {
+				successor = getFrameID(frameID.animID, frameID.indexID + 1);
+			}
+			else {
+				successor = transitionFrame(frameID, edge, 1);
+			}
+			assert(frameVec.directEdges.contains(successor));
+
+			edgeTargets.push_back(getNodeID(edge));
+			edgeSuccessors.push_back(getNodeID(successor));
+			edgeCosts.push_back(cost);
+		}
+
+		directOffsets.push_back(directTargets.size());
+		for (auto const& directEdge : frameVec.directEdges) {
+			directTargets.push_back(getNodeID(directEdge));
+		}
+	};
+	for (auto const& [frameID, frameVec] : FrameMat) {
+		compileFrame(frameID, frameVec);
+	}
+	for (auto const& [frameID, frameVec] : lazyFrames) {
+		compileFrame(frameID, frameVec);
+	}
+	edgeOffsets.push_back(edgeTargets.size());
+	directOffsets.push_back(directTargets.size());
+
+	compileMotions();
+}
+
+// heading of a rotation around the y axis, in the same way as Animation::unNormaliseTransform finds the yaw
+static float yaw(glm::quat rot) {
+	rot.x = 0;
+	rot.z = 0;
+	rot = glm::normalize(rot);
+	return 2.0f * std::atan2(rot.y, rot.w);
+}
+
+// precompute the motion along every edge & to every next frame, so the search reads flat records
+void Graph::compileMotions() {
+	const int N = nodeFrameIDs.size();
+
+	// the root of a frame is stored relative to its previous frame, which is where the search composes it onto
+	maxFrameArclength = 0.0f;
+	maxFrameDisplacement = 0.0f;
+	frameMotions.resize(directTargets.size());
+	for (NodeID node = 0; node < N; node++) {
+		for (int e = directOffsets[node]; e < directOffsets[node + 1]; e++) {
+			const NodeID next = directTargets[e];
+			frameMotions[e].next = next;
+			frameMotions[e].dArclen = dFrameArclength(node, next);
+
+			maxFrameArclength = std::max(maxFrameArclength, frameMotions[e].dArclen);
+			maxFrameDisplacement = std::max(maxFrameDisplacement, glm::length(glm::vec2(nodeRootPos[next][3][0], nodeRootPos[next][3][2])));
+		}
+	}
+
+	edgeMotions.resize(edgeTargets.size());
+	for (NodeID node = 0; node < N; node++) {
+		for (int e = edgeOffsets[node]; e < edgeOffsets[node + 1]; e++) {
+			const NodeID target = edgeTargets[e];
+			EdgeMotion& motion = edgeMotions[e];
+
+			motion.dArclen = dEdgeArclength(node, target);
+			motion.dPosition = dEdgePosition(node, target);
+
+			// walk the frames of the edge, composing the root transforms as the search does
+			glm::mat4 position;
+			glm::quat rotation;
+			sampleOffsets.push_back(segmentSamples.size());
+			[[maybe_unused]] const NodeID frame = sampleSegment(node, edgeSuccessors[e], target, segmentSamples, position, rotation);
+			assert(frame == target);
+
+			motion.rootPos = position;
+			motion.rootRot = rotation;
+			motion.dYaw = yaw(rotation);
+		}
+	}
+	sampleOffsets.push_back(segmentSamples.size());
+}
+
+Graph::NodeID Graph::sampleSegment(NodeID start, NodeID first, NodeID target, std::vector<SegmentSample>& samples, glm::mat4& rootPos, glm::quat& rootRot) const {
+	rootPos = glm::mat4(1.0f);
+	rootRot = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+
+	SegmentSample sample;
+	NodeID prev = start;
+	NodeID frame = first;
+	while (true) {
+		glm::mat4 nextPos = nodeRootPos[frame];
+		glm::quat nextRot = nodeRootRot[frame];
+		Animation::unNormaliseTransform(nextPos, nextRot, rootPos, rootRot);
+		rootPos = nextPos;
+		rootRot = nextRot;
+
+		sample.frame = frame;
+		sample.arclen += getFrameArclength(prev, frame);
+		sample.offset = glm::vec3(rootPos[3]);
+		samples.push_back(sample);
+
+		// frames in between nodes have a single next frame
+		const bool reached = target == -1 ? isNode(frame) : frame == target;
+		if (reached || directOffsets[frame] == directOffsets[frame + 1]) {
+			return frame;
+		}
+		prev = frame;
+		frame = directTargets[directOffsets[frame]];
+	}
+}
+
+int Graph::getNodeCount() const {
+	return nodeFrameIDs.size();
+}
+
+Graph::NodeID Graph::getNodeID(FrameID frameID) const {
+	if (!frameID.tMode && frameID.animID2 == -1 && frameID.indexID2 == -1 && frameID.alpha == -1) {
+		return getNodeID(frameID.animID, frameID.indexID);
+	}
+
+	// transitions are looked up with a binary search over the sorted frame ids
+	auto it = std::lower_bound(nodeFrameIDs.begin(), nodeFrameIDs.end(), frameID);
+	if (it == nodeFrameIDs.end() || *it != frameID) {
+		return -1;
+	}
+	return it - nodeFrameIDs.begin();
+}
+
+Graph::NodeID Graph::getNodeID(int animID, int indexID) const {
+	if (animID < 0 || animID >= (int)animOffsets.size() || animOffsets[animID] == -1
+		|| indexID < 0 || indexID >= animFrameCounts[animID]) {
+		return -1;
+	}
+	return animOffsets[animID] + indexID;
+}
+
+const Graph::FrameID& Graph::getFrameID(NodeID node) const {
+	return nodeFrameIDs[node];
+}
+
+std::span<const Graph::NodeID> Graph::getEdges(NodeID node) const {
+	return std::span<const NodeID>(edgeTargets.data() + edgeOffsets[node], edgeOffsets[node + 1] - edgeOffsets[node]);
+}
+
+std::span<const Graph::NodeID> Graph::getEdgeSuccessors(NodeID node) const {
+	return std::span<const NodeID>(edgeSuccessors.data() + edgeOffsets[node], edgeOffsets[node + 1] - edgeOffsets[node]);
+}
+
+std::span<const float> Graph::getEdgeCosts(NodeID node) const {
+	return std::span<const float>(edgeCosts.data() + edgeOffsets[node], edgeOffsets[node + 1] - edgeOffsets[node]);
+}
+
+std::span<const Graph::NodeID> Graph::getDirectEdges(NodeID node) const {
+	return std::span<const NodeID>(directTargets.data() + directOffsets[node], directOffsets[node + 1] - directOffsets[node]);
+}
+
+Graph::NodeID Graph::getSeqEdge(NodeID node) const {
+	return nodeSeqEdges[node];
+}
+
+float Graph::getArclen(NodeID node) const {
+	return nodeArclens[node];
+}
+
+const glm::vec3& Graph::getTruePos(NodeID node) const {
+	return nodeTruePos[node];
+}
+
+const glm::mat4& Graph::getRootPos(NodeID node) const {
+	return nodeRootPos[node];
+}
+
+const glm::quat& Graph::getRootRot(NodeID node) const {
+	return nodeRootRot[node];
+}
+
+bool Graph::isNode(NodeID node) const {
+	return nodeFlags[node] & (START_NODE | END_NODE);
+}
+
+bool Graph::isTransition(NodeID node) const {
+	return nodeFlags[node] & TRANSITION;
+}
+
+std::span<const Graph::EdgeMotion> Graph::getEdgeMotions(NodeID node) const {
+	return std::span<const EdgeMotion>(edgeMotions.data() + edgeOffsets[node], edgeOffsets[node + 1] - edgeOffsets[node]);
+}
+
+std::span<const Graph::FrameMotion> Graph::getFrameMotions(NodeID node) const {
+	return std::span<const FrameMotion>(frameMotions.data() + directOffsets[node], directOffsets[node + 1] - directOffsets[node]);
+}
+
+std::span<const Graph::SegmentSample> Graph::getEdgeSamples(NodeID node, int edge) const {
+	const int e = edgeOffsets[node] + edge;
+	return std::span<const SegmentSample>(segmentSamples.data() + sampleOffsets[e], sampleOffsets[e + 1] - sampleOffsets[e]);
+}
+
+float Graph::getFrameArclength(NodeID currNode, NodeID nextNode) const {
+	for (auto const& motion : getFrameMotions(currNode)) {
+		if (motion.next == nextNode) {
+			return motion.dArclen;
+		}
+	}
+	return -1.0f;
+}
+
+float Graph::getMaxFrameArclength() const {
+	return maxFrameArclength;
+}
+
+float Graph::getMaxFrameDisplacement() const {
+	return maxFrameDisplacement;
+}
+
+float Graph::dFrameArclength(NodeID currNode, NodeID nextNode) const {
+	const bool currTransition = isTransition(currNode);
+	const bool nextTransition = isTransition(nextNode);
+
+	float arclen = -1.0;
+	if (currTransition == nextTransition) {
+		arclen = nodeArclens[nextNode] - nodeArclens[currNode];
+	}
+	else if (!currTransition && nextTransition) {
+		arclen = nodeArclens[nextNode];
+	}
+	else if (currTransition && !nextTransition) {
+		const FrameID& currFrame = nodeFrameIDs[currNode];
+		arclen = nodeArclens[nextNode] - nodeArclens[getNodeID(currFrame.animID2, currFrame.indexID2)];
+	}
+
+	assert(arclen >= 0);
+	return arclen;
+}
+
+float Graph::dEdgeArclength(NodeID currNode, NodeID nextNode) const {
+	assert(isNode(currNode) && isNode(nextNode));
+
+	float arclen = -1.0;
+	if (nodeSeqEdges[currNode] == nextNode) {
+		arclen = nodeArclens[nextNode] - nodeArclens[currNode];
+	}
+	else {
+		arclen = nodeArclens[nextNode];
+	}
+
+	assert(arclen >= 0);
+	return arclen;
+}
+
+glm::vec3 Graph::dEdgePosition(NodeID currNode, NodeID nextNode) const {
+	assert(isNode(currNode) && isNode(nextNode));
+
+	if (nodeSeqEdges[currNode] == nextNode) {
+		return nodeTruePos[nextNode] - nodeTruePos[currNode];
+	}
+	else {
+		return nodeTruePos[nextNode];
+	}
+}
+
 // prints the graph
-std::string Graph::toString(bool print) {
+std::string Graph::toString(bool print) const {
 	std::string output = "";
 
 	for (auto const& [frameID, frameVec] : FrameMat) {
@@ -534,25 +1423,28 @@ std::string Graph::toString(FrameID frameID) {
 	}
 }
 
-void Graph::toFile(bool print) {
+void Graph::toFile(bool print) const {
+	std::filesystem::create_directories("output");
+
 	std::ofstream save_file;
 	save_file.open("output/graph.txt");
 
 	if (!save_file.is_open()) {
-		throw new std::exception("Error in Writing to File");
+		throw std::runtime_error("Error in Writing to File");
 	}
 
 	save_file << toString(print);
 	save_file.close();
 }
 
-bool Graph::isNode(int animID, int indexID) {
+bool Graph::isNode(int animID, int indexID) const {
 	FrameID key = getFrameID(animID, indexID);
 	return isNode(key);
 }
 
-bool Graph::isNode(FrameID frameID) {
-	if (FrameMat[frameID].isStartNode || FrameMat[frameID].isEndNode) {
+bool Graph::isNode(FrameID frameID) const {
+	auto it = FrameMat.find(frameID);
+	if (it != FrameMat.end() && (it->second.isStartNode || it->second.isEndNode)) {
 		return true;
 	}
 	else {
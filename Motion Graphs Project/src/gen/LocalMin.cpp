@@ -1,11 +1,11 @@
 #include <gen/LocalMin.h>
 #include <algorithm>
 
-std::vector<std::tuple<int, int>> LocalMin::localMinima(std::vector<std::vector<float>> distance_2d, int threshold, int STEP_SIZE) {
+std::vector<std::tuple<int, int, float>> LocalMin::localMinima(std::vector<std::vector<float>> distance_2d, int threshold, int STEP_SIZE) {
 
 	std::vector<float> minimums;
 	
-	std::vector<std::tuple<int, int>> result;
+	std::vector<std::tuple<int, int, float>> result;
 	const int direction_x[8] = {1, 1, 0, -1, -1, -1, 0, 1};
 	const int direction_y[8] = {0, 1, 1, 1, 0, -1, -1, -1};
 
@@ -34,7 +34,7 @@ std::vector<std::tuple<int, int>> LocalMin::localMinima(std::vector<std::vector<
 
 			// add if node if node is minimum, not zero, and is below threshold. (Thresholding is ignored if threshold == -1)
 			if (is_minimum && (threshold == -1 || distance_2d[i][j] <= threshold) || distance_2d[i][j] == 0) {
-				std::tuple<int, int> t = std::make_tuple(i * STEP_SIZE, j * STEP_SIZE);
+				std::tuple<int, int, float> t = std::make_tuple(i * STEP_SIZE, j * STEP_SIZE, distance_2d[i][j]);
 				result.push_back(t);
 			}
 
@@ -1,51 +1,6 @@
 #include <gen/Pipeline.h>
 
-void Pipeline::saveDistanceToFile(std::vector<std::vector<float>> distance, std::string filename) {
-	std::ofstream DistanceCSV(filename);
-	for (int i = 0; i < distance.size(); i++) {
-		for (int j = 0; j < distance[0].size(); j++) {
-			DistanceCSV << distance[i][j] << " ";
-		}
-		DistanceCSV << "\n";
-	}
-	DistanceCSV.close();
-}
-
-std::vector<std::vector<float>> Pipeline::loadDistanceFromFile(std::string filename) {
-
-	std::ifstream infile(filename);
-
-	if (!infile.is_open()) {
-		perror(("error while opening file " + filename).c_str());
-	}
-
-	std::vector<std::vector<float>> result;
-
-	for (std::string line; getline(infile, line); )
-	{
-		std::vector<float> tokens;
-
-		std::stringstream ss(line);
-		std::string word;
-		while (ss >> word) {
-			tokens.push_back(std::stof(word));
-		}
-
-		result.push_back(tokens);
-	}
-
-	return result;
-}
-
-Graph Pipeline::genGraph(const int WINDOW_SIZE, const int THRESHOLD, const int STEP_SIZE, const std::string graphdir) {
-
-	// variables
-	std::string asf_file;
-	std::vector<std::string> amc_files;
-
-	// setup path to mocap and distance directories
-	std::string mocap_dir = graphdir + "mocap/";
-	std::string distance_dir = graphdir + "distance/";
+void Pipeline::findMotionFiles(const std::string mocap_dir, std::string& asf_file, std::vector<std::string>& amc_files) {
 
 	// get all files in mocap directory
 	for (const auto& entry : std::filesystem::directory_iterator(mocap_dir)) {
@@ -75,83 +30,223 @@ Graph Pipeline::genGraph(const int WINDOW_SIZE, const int THRESHOLD, const int S
 		abort();
 	}
 
-	// get all .dist files in distance directory
-	std::vector<std::string> dist_files;
-	for (const auto& entry : std::filesystem::directory_iterator(distance_dir)) {
-		if (entry.path().extension() == ".dist") {
-			dist_files.push_back(entry.path().string());
+	// sort the filenames to ensure that [MOTION_1] < [MOTION_2] for consistency
+	std::sort(amc_files.begin(), amc_files.end());
+}
+
+std::map<std::string, int> Pipeline::loadGraphConfig(const std::string config_path) {
+
+	std::ifstream f(config_path);
+
+	// check if file is opened successfully
+	if (!f.is_open()) {
+		perror(("error while opening file " + config_path).c_str());
+		abort();
+	}
+
+	// fill up config map
+	std::map<std::string, int> config;
+	std::string line;
+	while (getline(f, line)) {
+		std::vector<std::string> line_tokens;
+		boost::split(line_tokens, line, [](char c) {return c == ' '; });
+
+		// skip blank lines
+		if (line_tokens.size() < 2) {
+			continue;
 		}
+
+		config[line_tokens[0]] = std::stoi(line_tokens[1]);
 	}
 
-	// generate skeleton
-	Skeleton* skeleton = new Skeleton(asf_file);
+	return config;
+}
+
+int Pipeline::getAnimationID(const std::string amc_file) {
+	return std::stoi(amc_file.substr(amc_file.size() - 6, 2));
+}
+
+void Pipeline::genEdges(Skeleton* skeleton, const std::string asf_file, const std::vector<std::string>& amc_files, const std::set<int>& onlyWith,
+	const int WINDOW_SIZE, const int THRESHOLD, const int STEP_SIZE, const std::string distance_dir, const int N_THREADS,
+	std::vector<Animation*>& animations, std::vector<Graph::Transition>& edges) {
+
+	// a pair of animations flowing through the stages
+	struct Pair {
+		int i;
+		int j;
+		std::string key;
+		bool cached;
+		std::vector<std::vector<float>> distance;
+		std::vector<Graph::Transition> edges;
+	};
+
+	// open the distance cache
+	DistanceCache cache(distance_dir);
+
+	// hash the skeleton and all motions once, the cache is keyed by file contents rather than filenames
+	std::string asf_hash = DistanceCache::hashFile(asf_file);
+	std::vector<std::string> amc_hashes;
+	for (auto const& amc_file : amc_files) {
+		amc_hashes.push_back(DistanceCache::hashFile(amc_file));
+	}
 
 	// for all combinations of motion (M X M), if distance matrix exists, load it, otherwise, generate it
-	// sort the filenames to ensure that [MOTION_1] < [MOTION_2] for consistency
-	std::sort(amc_files.begin(), amc_files.end());
+	const int M = amc_files.size();
+	std::vector<Pair> pairs;
+	std::vector<bool> needClouds(M, false);
+	for (int i = 0; i < M; i++) {
+		for (int j = i; j < M; j++) {		// for all combinations
+			const int amc_id1 = getAnimationID(amc_files[i]);
+			const int amc_id2 = getAnimationID(amc_files[j]);
+
+			// skip pairs that do not involve a new animation (incremental update)
+			if (!onlyWith.empty() && !onlyWith.contains(amc_id1) && !onlyWith.contains(amc_id2)) {
+				continue;
+			}
+
+			Pair pair;
+			pair.i = i;
+			pair.j = j;
+
+			// generate the cache key from the contents of [MOTION_1], [MOTION_2], [SKELETON] and the parameters
+			pair.key = DistanceCache::makeKey(amc_hashes[i], amc_hashes[j], asf_hash, WINDOW_SIZE, STEP_SIZE);
+			pair.cached = cache.contains(pair.key);
+
+			// point clouds are only needed for pairs that are generated
+			if (!pair.cached) {
+				needClouds[i] = true;
+				needClouds[j] = true;
+			}
 
-	std::map<std::tuple<int, int>, std::vector<std::vector<float>>> distance_mats;
-	for (int i = 0; i < amc_files.size(); i++) {
-		for (int j = i; j < amc_files.size(); j++) {		// for all combinations
-			// get amc file
-			auto amc_file1 = amc_files[i];
-			auto amc_file2 = amc_files[j];
+			pairs.push_back(pair);
+		}
+	}
 
-			// get amc id
-			auto amc_id1 = amc_file1.substr(amc_file1.size() - 6, 2);
-			auto amc_id2 = amc_file2.substr(amc_file2.size() - 6, 2);
+	// animations that are returned
+	std::vector<bool> isOutput(M, false);
+	for (int i = 0; i < M; i++) {
+		isOutput[i] = onlyWith.empty() || onlyWith.contains(getAnimationID(amc_files[i]));
+	}
 
-			// generate distance filenames from [MOTION 1]_[MOTION_2]_w[WINDOW_SIZE]_s[STEP_SIZE]
-			std::string distname = amc_id1 + "_" + amc_id2 + "_w" + std::to_string(WINDOW_SIZE) + "_s" + std::to_string(STEP_SIZE) + ".dist";
+	// schedule the stages: parse -> point cloud -> distance -> minima
+	// each pair flows through the stages on its own, so the stages of different pairs overlap
+	Scheduler scheduler(N_THREADS);
+	std::vector<Animation*> parsed(M, NULL);
+	std::vector<std::vector<Distance::PointCloud>> clouds(M);
+	std::vector<int> parseTasks(M, -1);
+	std::vector<int> cloudTasks(M, -1);
+
+	for (int i = 0; i < M; i++) {
+		if (isOutput[i] || needClouds[i]) {
+			parseTasks[i] = scheduler.addTask("parse", [&, i]() {
+				parsed[i] = new Animation(skeleton, amc_files[i]);
+			});
+		}
+	}
 
-			std::string dist_path = distance_dir + distname;
+	for (int i = 0; i < M; i++) {
+		if (needClouds[i]) {
+			cloudTasks[i] = scheduler.addTask("point cloud", [&, i]() {
+				clouds[i] = Distance::pointClouds(parsed[i], WINDOW_SIZE, STEP_SIZE);
+			}, { parseTasks[i] });
+		}
+	}
 
-			// make a pair of int denoting the first and second animation id
-			auto animation_pair = std::make_tuple(std::stoi(amc_id1), std::stoi(amc_id2));
+	for (auto& pair : pairs) {
+		std::vector<int> dependencies;
+		if (!pair.cached) {
+			dependencies = { cloudTasks[pair.i], cloudTasks[pair.j] };
+		}
 
-			// search of dist_path in dist_files. Load it if it exists, generate it if otherwise
-			if (std::find(dist_files.begin(), dist_files.end(), dist_path) != dist_files.end()) {
-				std::cout << "Loading " << dist_path << std::endl;
+		const int distanceTask = scheduler.addTask("distance", [&]() {
+			if (pair.cached && cache.load(pair.key, pair.distance)) {
+				return;
+			}
 
-				distance_mats[animation_pair] = loadDistanceFromFile(dist_path);
+			// the pair was evicted by another pair since it was scheduled, generate it from the files
+			if (pair.cached) {
+				Animation A1(skeleton, amc_files[pair.i]);
+				Animation A2(skeleton, amc_files[pair.j]);
+				pair.distance = Distance::distance(
+					Distance::pointClouds(&A1, WINDOW_SIZE, STEP_SIZE),
+					Distance::pointClouds(&A2, WINDOW_SIZE, STEP_SIZE));
 			}
 			else {
-				std::cout << "Generating " << dist_path << std::endl;
-				Animation A1(skeleton, amc_file1);
-				Animation A2(skeleton, amc_file2);
-				Distance distance_obj(&A1, &A2, WINDOW_SIZE);
+				pair.distance = Distance::distance(clouds[pair.i], clouds[pair.j]);
+			}
 
-				auto distance_mat = distance_obj.distance(STEP_SIZE);
+			cache.store(pair.key, pair.distance);
+		}, dependencies);
 
-				saveDistanceToFile(distance_mat, dist_path);
+		scheduler.addTask("minima", [&]() {
+			const int amc_id1 = getAnimationID(amc_files[pair.i]);
+			const int amc_id2 = getAnimationID(amc_files[pair.j]);
 
-				distance_mats[animation_pair] = distance_mat;
+			auto localminima = LocalMin::localMinima(pair.distance, THRESHOLD, STEP_SIZE);
+			for (auto lm : localminima) {
+				std::tuple<int, int> node1 = std::make_tuple(amc_id1, get<0>(lm));
+				std::tuple<int, int> node2 = std::make_tuple(amc_id2, get<1>(lm));
+				pair.edges.push_back(std::make_tuple(node1, node2, get<2>(lm)));
 			}
-		}
+
+			// the matrix is no longer needed
+			pair.distance = std::vector<std::vector<float>>();
+		}, { distanceTask });
 	}
 
-	// get all edges from all distance matrix
 	std::cout << "Generating Edges" << std::endl;
-	std::vector<std::tuple<std::tuple<int, int>, std::tuple<int, int>>> edges;
-	for (auto const& [key, val] : distance_mats) {
-		auto localminima = LocalMin::localMinima(val, THRESHOLD, STEP_SIZE);
-		for (auto lm : localminima) {
-			std::tuple<int, int> node1 = std::make_tuple(get<0>(key), get<0>(lm));
-			std::tuple<int, int> node2 = std::make_tuple(get<1>(key), get<1>(lm));
-			edges.push_back(std::make_tuple(node1, node2));
+	scheduler.run();
+	scheduler.printMetrics();
+
+	// get all edges from all pairs, ordered by animation id pair
+	std::map<std::tuple<int, int>, int> order;
+	for (int p = 0; p < pairs.size(); p++) {
+		order[std::make_tuple(getAnimationID(amc_files[pairs[p].i]), getAnimationID(amc_files[pairs[p].j]))] = p;
+	}
+	for (auto const& [key, p] : order) {
+		edges.insert(edges.end(), pairs[p].edges.begin(), pairs[p].edges.end());
+	}
+
+	// return the requested animations, free the rest
+	for (int i = 0; i < M; i++) {
+		if (isOutput[i]) {
+			animations.push_back(parsed[i]);
+		}
+		else if (parsed[i] != NULL) {
+			delete parsed[i];
 		}
 	}
+}
 
-	// load all animations
-	std::cout << "Creating All Animations" << std::endl;
+Graph Pipeline::genGraph(const int WINDOW_SIZE, const int THRESHOLD, const int STEP_SIZE, const std::string graphdir, const std::string cachedir, const int N_THREADS, const bool LAZY_TRANSITIONS, const int MAX_TRANSITIONS) {
+
+	// variables
+	std::string asf_file;
+	std::vector<std::string> amc_files;
+
+	// setup path to mocap and distance directories
+	std::string mocap_dir = graphdir + "mocap/";
+	std::string distance_dir = cachedir.empty() ? graphdir + "distance/" : cachedir;
+
+	// get all files in mocap directory
+	findMotionFiles(mocap_dir, asf_file, amc_files);
+
+	// generate skeleton
+	Skeleton* skeleton = new Skeleton(asf_file);
+
+	// parse all animations and get all edges from all distance matrices
+	auto start = std::chrono::steady_clock::now();
 	std::vector<Animation*> animations;
-	for (auto amc_file : amc_files) {
-		animations.push_back(new Animation(skeleton, amc_file));
-	}
+	std::vector<Graph::Transition> edges;
+	genEdges(skeleton, asf_file, amc_files, {}, WINDOW_SIZE, THRESHOLD, STEP_SIZE, distance_dir, N_THREADS, animations, edges);
+	std::cout << "Edges Generated in " << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << "s" << std::endl;
 
 	// generate the graph using all local minimums
+	start = std::chrono::steady_clock::now();
 	std::cout << "Creating The Graph" << std::endl;
-	Graph graph(skeleton, animations, edges, WINDOW_SIZE);
+	Graph graph(skeleton, animations, edges, WINDOW_SIZE, LAZY_TRANSITIONS, N_THREADS, MAX_TRANSITIONS);
+	graph.setSources(settingsKey(asf_file, WINDOW_SIZE, THRESHOLD, STEP_SIZE, LAZY_TRANSITIONS, MAX_TRANSITIONS), hashMotionFiles(amc_files));
+	std::cout << "Graph Created in " << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << "s" << std::endl;
 
 	// print graph
 	//std::cout << "Start Printing Graph" << std::endl;
@@ -161,5 +256,151 @@ Graph Pipeline::genGraph(const int WINDOW_SIZE, const int THRESHOLD, const int S
 	return graph;
 }
 
+std::map<int, std::string> Pipeline::hashMotionFiles(const std::vector<std::string>& amc_files) {
+	std::map<int, std::string> amc_hashes;
+	for (auto const& amc_file : amc_files) {
+		amc_hashes[getAnimationID(amc_file)] = DistanceCache::hashFile(amc_file);
+	}
+	return amc_hashes;
+}
+
+std::string Pipeline::settingsKey(const std::string asf_file, const int WINDOW_SIZE, const int THRESHOLD, const int STEP_SIZE, const bool LAZY_TRANSITIONS, const int MAX_TRANSITIONS) {
+
+	// all inputs other than the animations that affect the graph go into the key
+	std::string description = "d" + std::to_string(Distance::VERSION)
+		+ "_" + DistanceCache::hashFile(asf_file)
+		+ "_w" + std::to_string(WINDOW_SIZE)
+		+ "_t" + std::to_string(THRESHOLD)
+		+ "_s" + std::to_string(STEP_SIZE)
+		+ "_l" + std::to_string(LAZY_TRANSITIONS)
+		+ "_k" + std::to_string(MAX_TRANSITIONS);
+
+	return DistanceCache::hashString(description);
+}
+
+std::string Pipeline::snapshotKey(const std::string settings_key, const std::map<int, std::string>& amc_hashes) {
 
+	// the settings & the animations, the animation ids come from the filenames
+	std::string description = "v" + std::to_string(Graph::SNAPSHOT_VERSION) + "_" + settings_key;
+	for (auto const& [amc_id, amc_hash] : amc_hashes) {
+		description += "_" + std::to_string(amc_id) + ":" + amc_hash;
+	}
+
+	return DistanceCache::hashString(description);
+}
 
+Graph Pipeline::loadGraph(const int WINDOW_SIZE, const int THRESHOLD, const int STEP_SIZE, const std::string graphdir, const std::string cachedir, const int N_THREADS, const bool LAZY_TRANSITIONS, const int MAX_TRANSITIONS) {
+	auto start = std::chrono::steady_clock::now();
+
+	// variables
+	std::string asf_file;
+	std::vector<std::string> amc_files;
+	std::string snapshot_path = graphdir + "graph.snapshot";
+
+	// get all files in mocap directory
+	findMotionFiles(graphdir + "mocap/", asf_file, amc_files);
+	std::string settings_key = settingsKey(asf_file, WINDOW_SIZE, THRESHOLD, STEP_SIZE, LAZY_TRANSITIONS, MAX_TRANSITIONS);
+	std::string key = snapshotKey(settings_key, hashMotionFiles(amc_files));
+
+	// use the snapshot if it is up to date
+	if (Graph::isSnapshotCurrent(snapshot_path, key)) {
+		try {
+			Graph graph(snapshot_path);
+			std::cout << "Graph Loaded in " << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << "s" << std::endl;
+			return graph;
+		}
+		catch (const std::runtime_error& e) {
+			std::cout << "Failed to load " << snapshot_path << ": " << e.what() << std::endl;
+		}
+	}
+	else if (std::filesystem::exists(snapshot_path)) {
+		std::cout << "Graph Snapshot " << snapshot_path << " is stale" << std::endl;
+
+		// a snapshot of the same settings only needs the animations that changed
+		try {
+			Graph graph(snapshot_path);
+			if (graph.getSettingsKey() == settings_key && updateGraph(graph, WINDOW_SIZE, THRESHOLD, STEP_SIZE, graphdir, cachedir, N_THREADS)) {
+				graph.saveSnapshot(snapshot_path, key);
+				graph.setKey(key);
+				std::cout << "Graph Updated in " << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << "s" << std::endl;
+				return graph;
+			}
+		}
+		catch (const std::runtime_error& e) {
+			std::cout << "Failed to update " << snapshot_path << ": " << e.what() << std::endl;
+		}
+	}
+	else {
+		std::cout << "Graph Snapshot " << snapshot_path << " is missing" << std::endl;
+	}
+
+	// rebuild the graph and save it for the next launch
+	Graph graph = genGraph(WINDOW_SIZE, THRESHOLD, STEP_SIZE, graphdir, cachedir, N_THREADS, LAZY_TRANSITIONS, MAX_TRANSITIONS);
+	graph.saveSnapshot(snapshot_path, key);
+	graph.setKey(key);
+	std::cout << "Graph Built in " << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << "s" << std::endl;
+
+	return graph;
+}
+
+bool Pipeline::updateGraph(Graph& graph, const int WINDOW_SIZE, const int THRESHOLD, const int STEP_SIZE, const std::string graphdir, const std::string cachedir, const int N_THREADS) {
+
+	// variables
+	std::string asf_file;
+	std::vector<std::string> amc_files;
+
+	// setup path to mocap and distance directories
+	std::string mocap_dir = graphdir + "mocap/";
+	std::string distance_dir = cachedir.empty() ? graphdir + "distance/" : cachedir;
+
+	// get all files in mocap directory
+	findMotionFiles(mocap_dir, asf_file, amc_files);
+
+	// the graph can only be patched with the settings it was built with
+	std::string settings_key = settingsKey(asf_file, WINDOW_SIZE, THRESHOLD, STEP_SIZE, graph.hasLazyTransitions(), graph.getMaxTransitions());
+	if (graph.getSettingsKey() != settings_key) {
+		std::cout << "Graph was built with other settings, it cannot be updated" << std::endl;
+		return false;
+	}
+
+	// compare the animations on disk with the animations in the graph, an animation whose file changed is removed &
+	// added again
+	std::map<int, std::string> disk_hashes = hashMotionFiles(amc_files);
+	const std::map<int, std::string>& graph_hashes = graph.getAnimationHashes();
+	std::set<int> added_ids;
+	for (auto const& [amc_id, amc_hash] : disk_hashes) {
+		auto graph_hash = graph_hashes.find(amc_id);
+		if (graph_hash == graph_hashes.end() || graph_hash->second != amc_hash) {
+			added_ids.insert(amc_id);
+		}
+	}
+
+	std::vector<int> removed_ids;
+	for (const int graph_id : graph.getAnimationIDs()) {
+		auto graph_hash = graph_hashes.find(graph_id);
+		auto disk_hash = disk_hashes.find(graph_id);
+		if (graph_hash == graph_hashes.end() || disk_hash == disk_hashes.end() || disk_hash->second != graph_hash->second) {
+			removed_ids.push_back(graph_id);
+		}
+	}
+
+	std::cout << "Updating The Graph: " << added_ids.size() << " Added, " << removed_ids.size() << " Removed" << std::endl;
+
+	// nothing to do
+	if (added_ids.empty() && removed_ids.empty()) {
+		return true;
+	}
+
+	// only the pairs with a new animation are loaded or generated, the rest of the edges are already in the graph
+	std::vector<Graph::Transition> edges;
+	std::vector<Animation*> animations;
+	if (!added_ids.empty()) {
+		genEdges(graph.getSkeleton(), asf_file, amc_files, added_ids, WINDOW_SIZE, THRESHOLD, STEP_SIZE, distance_dir, N_THREADS, animations, edges);
+	}
+
+	// patch the graph
+	graph.update(animations, removed_ids, edges);
+	graph.setSources(settings_key, disk_hashes);
+
+	return true;
+}
@@ -0,0 +1,133 @@
+#include <gen/PlanCache.h>
+
+PlanCache::PlanCache(const std::string _cachedir, const long long _quota) : index(_cachedir, ".plan", _quota) {
+}
+
+std::string PlanCache::makeKey(const Graph& graph, Graph::FrameID start, const std::vector<glm::vec3>& points, float pathRadius, const std::string search) {
+	if (graph.getKey().empty()) {
+		return "";
+	}
+
+	// all inputs that affect the plan go into the key
+	std::string description = "v" + std::to_string(VERSION)
+		+ "_" + graph.getKey()
+		+ "_" + std::to_string(start.pack())
+		+ "_r" + std::to_string(pathRadius)
+		+ "_" + search;
+	for (auto const& point : points) {
+		description += "_" + std::to_string(std::lround(point[0] / POINT_QUANTUM))
+			+ "," + std::to_string(std::lround(point[2] / POINT_QUANTUM));
+	}
+
+	return DistanceCache::hashString(description);
+}
+
+bool PlanCache::load(const std::string key, const Graph& graph, std::vector<Graph::NodeID>& nodes) {
+
+	// mark as recently used, the index is written with the next store or when the cache is closed
+	long long size = 0;
+	if (!index.touch(key, size)) {
+		return false;
+	}
+
+	// the file may be evicted by a store of another thread or process while it is read, which is a miss
+	if (!loadPlanFromFile(index.entryPath(key), size, graph, nodes)) {
+		index.missing(key);
+		return false;
+	}
+
+	return true;
+}
+
+void PlanCache::store(const std::string key, const Graph& graph, const std::vector<Graph::NodeID>& nodes) {
+
+	// runs of frames that each follow on to the first next frame of the one before, which is most of a path as clips
+	// & transitions are played through frame by frame
+	std::vector<std::pair<std::uint64_t, std::uint32_t>> runs;
+	for (int i = 0; i < (int)nodes.size(); i++) {
+		if (i > 0 && nodes[i] == firstNext(graph, nodes[i - 1])) {
+			runs.back().second++;
+		}
+		else {
+			runs.push_back(std::make_pair(graph.getFrameID(nodes[i]).pack(), 1));
+		}
+	}
+
+	// write to a temporary file first so an interrupted write never leaves a plan that looks complete
+	const std::string temp_path = index.entryPath(key) + ".tmp";
+	std::ofstream outfile(temp_path, std::ios::binary);
+
+	if (!outfile.is_open()) {
+		std::cout << "Error in Writing to File " << temp_path << std::endl;
+		return;
+	}
+
+	const std::int32_t version = VERSION;
+	const std::uint32_t n_runs = runs.size();
+	outfile.write((const char*)&version, sizeof(version));
+	outfile.write((const char*)&n_runs, sizeof(n_runs));
+	for (auto const& [first, length] : runs) {
+		outfile.write((const char*)&first, sizeof(first));
+		outfile.write((const char*)&length, sizeof(length));
+	}
+	outfile.close();
+
+	if (!outfile) {
+		std::cout << "Error in Writing to File " << temp_path << std::endl;
+		std::error_code error;
+		std::filesystem::remove(temp_path, error);
+		return;
+	}
+
+	// store runs on the planner thread, a plan that cannot be moved into place is not cached rather than an error
+	index.add(key, temp_path);
+}
+
+// Read a plan written by store. Returns false if the file is missing, is not size bytes long, is of another version,
+// or a frame of it is not in the graph
+bool PlanCache::loadPlanFromFile(std::string filename, long long size, const Graph& graph, std::vector<Graph::NodeID>& nodes) {
+	std::ifstream infile(filename, std::ios::binary);
+
+	if (!infile.is_open()) {
+		return false;
+	}
+
+	std::error_code error;
+	if ((long long)std::filesystem::file_size(filename, error) != size || error) {
+		return false;
+	}
+
+	std::int32_t version = 0;
+	std::uint32_t n_runs = 0;
+	infile.read((char*)&version, sizeof(version));
+	infile.read((char*)&n_runs, sizeof(n_runs));
+	if (!infile || version != VERSION) {
+		return false;
+	}
+
+	nodes.clear();
+	for (std::uint32_t i = 0; i < n_runs; i++) {
+		std::uint64_t first = 0;
+		std::uint32_t length = 0;
+		infile.read((char*)&first, sizeof(first));
+		infile.read((char*)&length, sizeof(length));
+
+		// the entry does not fit the graph if a frame is missing or a run leaves it
+		Graph::NodeID node = infile ? graph.getNodeID(Graph::FrameID::unpack(first)) : -1;
+		for (std::uint32_t j = 0; j < length; j++) {
+			if (node == -1) {
+				nodes.clear();
+				return false;
+			}
+			nodes.push_back(node);
+			node = j + 1 < length ? firstNext(graph, node) : node;
+		}
+	}
+
+	return !nodes.empty();
+}
+
+Graph::NodeID PlanCache::firstNext(const Graph& graph, Graph::NodeID node) {
+	const auto next = graph.getDirectEdges(node);
+	return next.empty() ? -1 : next[0];
+}
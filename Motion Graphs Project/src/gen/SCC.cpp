@@ -0,0 +1,285 @@
+#include <gen/SCC.h>
+
+std::vector<int> SCC::tarjan(const std::vector<int>& offsets, const std::vector<int>& targets) {
+	const int N = offsets.size() - 1;
+
+	std::vector<int> index(N, -1);
+	std::vector<int> lowlink(N, -1);
+	std::vector<int> components(N, -1);
+	std::vector<bool> onStack(N, false);
+	std::vector<int> stack;
+	int counter = 0;
+	int n_components = 0;
+
+	// explicit call stack of (node, position of the next edge to visit)
+	std::vector<std::pair<int, int>> calls;
+
+	for (int s = 0; s < N; s++) {
+		if (index[s] != -1) {
+			continue;
+		}
+
+		index[s] = lowlink[s] = counter++;
+		stack.push_back(s);
+		onStack[s] = true;
+		calls.push_back(std::make_pair(s, offsets[s]));
+
+		while (!calls.empty()) {
+			const int v = calls.back().first;
+			const int e = calls.back().second;
+
+			// visit the next edge of v
+			if (e < offsets[v + 1]) {
+				calls.back().second++;
+
+				const int w = targets[e];
+				if (index[w] == -1) {
+					index[w] = lowlink[w] = counter++;
+					stack.push_back(w);
+					onStack[w] = true;
+					calls.push_back(std::make_pair(w, offsets[w]));
+				}
+				else if (onStack[w]) {
+					lowlink[v] = std::min(lowlink[v], index[w]);
+				}
+				continue;
+			}
+
+			// all edges visited, v is the root of a component if nothing below it reaches further up
+			calls.pop_back();
+			if (lowlink[v] == index[v]) {
+				int u;
+				do {
+					u = stack.back();
+					stack.pop_back();
+					onStack[u] = false;
+					components[u] = n_components;
+				} while (u != v);
+				n_components++;
+			}
+
+			// return to the caller
+			if (!calls.empty()) {
+				const int caller = calls.back().first;
+				lowlink[caller] = std::min(lowlink[caller], lowlink[v]);
+			}
+		}
+	}
+
+	return components;
+}
+
+// mark all nodes of the given color reachable from pivot with epoch
+// level synchronous, so large frontiers can be split between threads
+void SCC::reach(const int pivot, const int color, const int epoch, const std::vector<int>& offsets, const std::vector<int>& targets,
+	const std::vector<int>& colors, std::vector<std::atomic<int>>& marks, const int n_threads) {
+
+	// expand part of the frontier, marking each node once
+	auto expand = [&](const std::vector<int>& frontier, size_t begin, size_t end, std::vector<int>& next) {
+		for (size_t i = begin; i < end; i++) {
+			const int v = frontier[i];
+			for (int e = offsets[v]; e < offsets[v + 1]; e++) {
+				const int w = targets[e];
+				if (colors[w] != color) {
+					continue;
+				}
+
+				int mark = marks[w].load(std::memory_order_relaxed);
+				if (mark != epoch && marks[w].compare_exchange_strong(mark, epoch, std::memory_order_relaxed)) {
+					next.push_back(w);
+				}
+			}
+		}
+	};
+
+	marks[pivot].store(epoch, std::memory_order_relaxed);
+	std::vector<int> frontier = { pivot };
+
+	while (!frontier.empty()) {
+		std::vector<int> next;
+
+		if (n_threads > 1 && (int)frontier.size() >= PARALLEL_FRONTIER) {
+			std::vector<std::vector<int>> nexts(n_threads);
+			std::vector<std::thread> threads;
+			const size_t chunk = (frontier.size() + n_threads - 1) / n_threads;
+
+			for (int t = 0; t < n_threads; t++) {
+				const size_t begin = std::min(frontier.size(), t * chunk);
+				const size_t end = std::min(frontier.size(), begin + chunk);
+				threads.push_back(std::thread([&, t, begin, end]() { expand(frontier, begin, end, nexts[t]); }));
+			}
+			for (auto& thread : threads) {
+				thread.join();
+			}
+			for (auto const& part : nexts) {
+				next.insert(next.end(), part.begin(), part.end());
+			}
+		}
+		else {
+			expand(frontier, 0, frontier.size(), next);
+		}
+
+		frontier.swap(next);
+	}
+}
+
+std::vector<int> SCC::forwardBackward(const std::vector<int>& offsets, const std::vector<int>& targets, int n_threads) {
+	const int N = offsets.size() - 1;
+
+	if (n_threads <= 0) {
+		n_threads = std::max(1, (int)std::thread::hardware_concurrency());
+	}
+
+	// reverse edges
+	std::vector<int> rOffsets(N + 1, 0);
+	std::vector<int> rTargets(targets.size());
+	for (const int w : targets) {
+		rOffsets[w + 1]++;
+	}
+	for (int v = 0; v < N; v++) {
+		rOffsets[v + 1] += rOffsets[v];
+	}
+	std::vector<int> fill(rOffsets.begin(), rOffsets.end() - 1);
+	for (int v = 0; v < N; v++) {
+		for (int e = offsets[v]; e < offsets[v + 1]; e++) {
+			rTargets[fill[targets[e]]++] = v;
+		}
+	}
+
+	// every unassigned node belongs to a partition (color), the components never cross partitions
+	// assigned nodes get the color -1
+	std::vector<int> components(N, -1);
+	std::vector<int> colors(N, 0);
+	std::vector<std::atomic<int>> forwardMarks(N);
+	std::vector<std::atomic<int>> backwardMarks(N);
+	for (int v = 0; v < N; v++) {
+		forwardMarks[v].store(-1, std::memory_order_relaxed);
+		backwardMarks[v].store(-1, std::memory_order_relaxed);
+	}
+	std::vector<int> inDegree(N, 0);
+	std::vector<int> outDegree(N, 0);
+	int n_components = 0;
+	int n_colors = 1;
+
+	std::vector<std::pair<int, std::vector<int>>> partitions;
+	std::vector<int> all(N);
+	for (int v = 0; v < N; v++) {
+		all[v] = v;
+	}
+	partitions.push_back(std::make_pair(0, all));
+
+	while (!partitions.empty()) {
+		const int color = partitions.back().first;
+		std::vector<int> nodes = std::move(partitions.back().second);
+		partitions.pop_back();
+
+		// trim nodes without incoming or outgoing edges inside the partition, each is a component of its own
+		std::vector<int> trim;
+		for (const int v : nodes) {
+			inDegree[v] = 0;
+			outDegree[v] = 0;
+			for (int e = offsets[v]; e < offsets[v + 1]; e++) {
+				outDegree[v] += colors[targets[e]] == color;
+			}
+			for (int e = rOffsets[v]; e < rOffsets[v + 1]; e++) {
+				inDegree[v] += colors[rTargets[e]] == color;
+			}
+			if (inDegree[v] == 0 || outDegree[v] == 0) {
+				trim.push_back(v);
+			}
+		}
+		while (!trim.empty()) {
+			const int v = trim.back();
+			trim.pop_back();
+			if (colors[v] != color) {
+				continue;
+			}
+
+			components[v] = n_components++;
+			colors[v] = -1;
+
+			for (int e = offsets[v]; e < offsets[v + 1]; e++) {
+				const int w = targets[e];
+				if (colors[w] == color && --inDegree[w] == 0) {
+					trim.push_back(w);
+				}
+			}
+			for (int e = rOffsets[v]; e < rOffsets[v + 1]; e++) {
+				const int w = rTargets[e];
+				if (colors[w] == color && --outDegree[w] == 0) {
+					trim.push_back(w);
+				}
+			}
+		}
+		std::erase_if(nodes, [&](const int v) { return colors[v] != color; });
+
+		if (nodes.empty()) {
+			continue;
+		}
+
+		// the component of the pivot is the intersection of its forward & backward reachable sets
+		const int pivot = nodes[0];
+		const int epoch = color;
+		reach(pivot, color, epoch, offsets, targets, colors, forwardMarks, n_threads);
+		reach(pivot, color, epoch, rOffsets, rTargets, colors, backwardMarks, n_threads);
+
+		// split the rest into the forward only, backward only & unreached partitions
+		const int forwardColor = n_colors++;
+		const int backwardColor = n_colors++;
+		const int restColor = n_colors++;
+		std::vector<int> forwardNodes;
+		std::vector<int> backwardNodes;
+		std::vector<int> restNodes;
+		const int component = n_components++;
+
+		for (const int v : nodes) {
+			const bool forward = forwardMarks[v].load(std::memory_order_relaxed) == epoch;
+			const bool backward = backwardMarks[v].load(std::memory_order_relaxed) == epoch;
+
+			if (forward && backward) {
+				components[v] = component;
+				colors[v] = -1;
+			}
+			else if (forward) {
+				colors[v] = forwardColor;
+				forwardNodes.push_back(v);
+			}
+			else if (backward) {
+				colors[v] = backwardColor;
+				backwardNodes.push_back(v);
+			}
+			else {
+				colors[v] = restColor;
+				restNodes.push_back(v);
+			}
+		}
+
+		for (auto* part : { &forwardNodes, &backwardNodes, &restNodes }) {
+			if (!part->empty()) {
+				partitions.push_back(std::make_pair(colors[part->front()], std::move(*part)));
+			}
+		}
+	}
+
+	return components;
+}
+
+int SCC::largest(const std::vector<int>& components) {
+	if (components.empty()) {
+		return -1;
+	}
+
+	std::vector<int> sizes(*std::max_element(components.begin(), components.end()) + 1, 0);
+	for (const int component : components) {
+		sizes[component]++;
+	}
+
+	// visit the nodes in order so ties go to the component of the lowest node
+	int largest = components[0];
+	for (const int component : components) {
+		if (sizes[component] > sizes[largest]) {
+			largest = component;
+		}
+	}
+	return largest;
+}
@@ -0,0 +1,235 @@
+#include <mogen/BeamMG.h>
+
+#include <ctime>
+#include <tuple>
+#include <limits>
+#include <algorithm>
+
+std::vector<float> BeamMG::getNextFrame(bool* completed) {
+
+	*completed = false;
+
+	Animation* currAnim = graph->getAnimation(currFrameID.animID);
+
+	// do nothing if path is not set
+	if (path.empty()) {
+		currAnim->calculateFrame(currFrame);
+		return currAnim->getVertices();
+	}
+
+	// reset index to loop the animation
+	if (pathIdx >= path.size()) {
+		MotionGenerator::reset();
+		pathIdx = 0;
+		*completed = true;
+	}
+
+	// select next edge
+	currFrameID = graph->getFrameID(path[pathIdx]);
+	currFrame = graph->getFrame(currFrameID);
+	Animation::unNormaliseFrame(currFrame, currPos, currRot);
+	currPos = currFrame.pos;
+	currRot = currFrame.pose["root"];
+
+	pathIdx++;
+
+	currAnim = graph->getAnimation(currFrameID.animID);
+	currAnim->calculateFrame(currFrame);
+	return currAnim->getVertices();
+}
+
+glm::vec4 BeamMG::getColour() {
+	if (path.empty() || pathIdx >= path.size()) {
+		return glm::vec4(0.25f, 0.25f, 0.25f, 1.0f);	// grey
+	}
+	else if (currFrameID.tMode) {
+		return glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);		// blue
+	}
+	else {
+		return glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);		// red
+	}
+}
+
+void BeamMG::setPath(const std::vector<float>& line) {
+
+	std::vector<glm::vec3> pathline;
+
+	// generate pathline: vector of vec3s
+	// skip first point
+	for (int i = 3; i < line.size(); i += 6) {
+		pathline.push_back(glm::vec3(line[i + 0], line[i + 1], line[i + 2]));
+	}
+
+	// set path radius, should be equivalent to main::PATH_RADIUS
+	float pathRadius = std::round(glm::distance(pathline[0], pathline[1]));
+
+	std::clock_t start = std::clock();
+	searchPath(graph->getNodeID(currFrameID), pathline, pathRadius);
+	std::clock_t end = std::clock();
+	planningTime = double(end - start) / CLOCKS_PER_SEC;
+
+	std::cout << "Beam Width: " << beamWidth << std::endl;
+	std::cout << "CPU time used: " << planningTime << " seconds\n";
+	std::cout << "Frames Expanded: " << expandedFrames << std::endl;
+	std::cout << "Path Error: " << pathError << std::endl;
+}
+
+// Breadth first over the depths, the partial paths of a depth are expanded by one frame & the beamWidth cheapest are kept
+// A complete path ends its partial path, & the search stops once no partial path is cheaper than the best complete one
+void BeamMG::searchPath(Graph::NodeID start_node, const std::vector<glm::vec3>& pathline, float pathRadius) {
+
+	beam.clear();
+	trail.clear();
+	path.clear();
+	pathIdx = 0;
+	expandedFrames = 0;
+
+	beam.push_back({ start_node, currPos, currRot, 0, 0, 0 });
+	trail.push_back(std::make_pair(start_node, -1));
+
+	float bestCost = std::numeric_limits<float>::max();
+	int best = -1;		// last frame of the best complete path in the trail
+	size_t compactAt = (size_t)TRAIL_PER_WIDTH * beamWidth;
+
+	for (int depth = 0; !beam.empty(); depth++) {
+
+		// complete paths end here
+		std::erase_if(beam, [&](const Beam& b) {
+			if (!isComplete(glm::vec3(b.position[3]), b.arclen, pathline)) {
+				return false;
+			}
+			if (b.cost < bestCost) {
+				bestCost = b.cost;
+				best = b.trail;
+			}
+			return true;
+		});
+
+		if (beam.empty()) {
+			break;
+		}
+
+		if (depth >= MAX_PATH_LENGTH && MAX_PATH_LENGTH != -1) {
+			std::cout << "Warning, Maximum Path Limit Reached " << std::endl;
+			if (best == -1) {
+				const auto& cheapest = *std::min_element(beam.begin(), beam.end(), [](const Beam& b1, const Beam& b2) { return b1.cost < b2.cost; });
+				bestCost = cheapest.cost;
+				best = cheapest.trail;
+			}
+			break;
+		}
+
+		// the error of a frame is added when leaving it, so all next frames of a partial path share a cost
+		candidates.clear();
+		for (int i = 0; i < beam.size(); i++) {
+			const float error = pathCost(glm::vec3(beam[i].position[3]), beam[i].arclen, pathline, pathRadius);
+			const float cost = beam[i].cost + std::pow(error, 2);	// sum of squared error
+
+			// costs only grow, nothing beats the best complete path from here
+			if (cost >= bestCost) {
+				continue;
+			}
+			for (const auto next : graph->getDirectEdges(beam[i].node)) {
+				candidates.push_back({ cost, i, next });
+			}
+		}
+		expandedFrames += candidates.size();
+
+		// keep the cheapest, ties go to the first partial path & frame so the result is deterministic
+		if (candidates.size() > beamWidth) {
+			std::nth_element(candidates.begin(), candidates.begin() + beamWidth, candidates.end(), [](const Candidate& c1, const Candidate& c2) {
+				return std::tie(c1.cost, c1.parent, c1.next) < std::tie(c2.cost, c2.parent, c2.next);
+				});
+			candidates.resize(beamWidth);
+		}
+
+		// move the kept partial paths by one frame
+		nextBeam.clear();
+		for (auto const& candidate : candidates) {
+			const Beam& parent = beam[candidate.parent];
+
+			Beam next;
+			next.node = candidate.next;
+			next.position = graph->getRootPos(candidate.next);
+			next.rotation = graph->getRootRot(candidate.next);
+			Animation::unNormaliseTransform(next.position, next.rotation, parent.position, parent.rotation);
+			next.arclen = parent.arclen + graph->getFrameArclength(parent.node, candidate.next);
+			next.cost = candidate.cost;
+			next.trail = trail.size();
+			trail.push_back(std::make_pair(candidate.next, parent.trail));
+			nextBeam.push_back(next);
+		}
+		beam.swap(nextBeam);
+
+		// the trail grows by beamWidth frames every depth, most of them on partial paths that were pruned since
+		// dropping those once the trail has doubled keeps it proportional to the frames the kept paths lead back through
+		if (trail.size() >= compactAt) {
+			compactTrail(best);
+			compactAt = std::max(2 * trail.size(), (size_t)TRAIL_PER_WIDTH * beamWidth);
+		}
+	}
+
+	// follow the trail back from the last frame
+	for (int t = best; t != -1; t = trail[t].second) {
+		path.push_back(trail[t].first);
+	}
+	std::reverse(path.begin(), path.end());
+	pathError = bestCost;
+}
+
+// Keep only the frames of the trail that the beam & the best complete path lead back through
+// The kept frames stay in order, so the previous frame of each still comes before it
+void BeamMG::compactTrail(int& best) {
+	trailMap.assign(trail.size(), -1);
+
+	// mark the kept frames, a walk stops at the first frame marked by another walk
+	auto mark = [&](int t) {
+		for (; t != -1 && trailMap[t] == -1; t = trail[t].second) {
+			trailMap[t] = 0;
+		}
+	};
+	for (auto const& b : beam) {
+		mark(b.trail);
+	}
+	mark(best);
+
+	int kept = 0;
+	for (int t = 0; t < (int)trail.size(); t++) {
+		if (trailMap[t] == -1) {
+			continue;
+		}
+		const int previous = trail[t].second;
+		trailMap[t] = kept;
+		trail[kept++] = std::make_pair(trail[t].first, previous == -1 ? -1 : trailMap[previous]);
+	}
+	trail.resize(kept);
+
+	for (auto& b : beam) {
+		b.trail = trailMap[b.trail];
+	}
+	if (best != -1) {
+		best = trailMap[best];
+	}
+}
+
+void BeamMG::setBeamWidth(int _beamWidth) {
+	beamWidth = std::max(1, _beamWidth);
+}
+
+double BeamMG::getPlanningTime() const {
+	return planningTime;
+}
+
+float BeamMG::getPathError() const {
+	return pathError;
+}
+
+long long BeamMG::getExpandedFrames() const {
+	return expandedFrames;
+}
+
+void BeamMG::reset() {
+	MotionGenerator::reset();
+	path.clear();
+	pathIdx = 0;
+}
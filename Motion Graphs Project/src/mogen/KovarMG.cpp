@@ -1,5 +1,6 @@
 #include <mogen/KovarMG.h>
 #include <ctime>
+#include <chrono>
 
 int n_transition_frames = 0;
 float lfootslide = 0;
@@ -14,27 +15,33 @@ std::vector<float> KovarMG::getNextFrame(bool* completed) {
 
 	Animation* currAnim = graph->getAnimation(currFrameID.animID);
 
-	// do nothing if path is not set
-	if (path.nodes.empty()) {
-		currAnim->calculateFrame(currFrame);
-		return currAnim->getVertices();
-	}
+	Graph::NodeID node;
+	{
+		std::lock_guard<std::mutex> lock(planMutex);
 
-	// reset index to loop the animation
-	if (pathIdx >= path.nodes.size()) {
-		currFrameID = graph->getFirstNode();
-		currFrame = Animation::Frame(graph->getFrameVec(currFrameID).pose);
-		currFrame.pos[3][1] = graph->getRealPos(currFrameID)[3][1];
-		currPos = currFrame.pos;
-		currRot = currFrame.pose["root"];
-		pathIdx = 0;
-		*completed = true;
+		// do nothing if path is not set, or hold the current frame until the planner commits the next window
+		if (committed.empty() || (pathIdx >= committed.size() && planning)) {
+			currAnim->calculateFrame(currFrame);
+			return currAnim->getVertices();
+		}
+
+		// reset index to loop the animation
+		if (pathIdx >= committed.size()) {
+			currFrameID = graph->getFirstNode();
+			currFrame = graph->getFrame(currFrameID);
+			currFrame.pos[3][1] = graph->getRealPos(currFrameID)[3][1];
+			currPos = currFrame.pos;
+			currRot = currFrame.pose["root"];
+			pathIdx = 0;
+			*completed = true;
+		}
+
+		node = committed[pathIdx];
 	}
 
 	// select next edge
-	currFrameID = path.nodes[pathIdx];
-	const auto& currFrameData = graph->getFrameVec(currFrameID);
-	currFrame = currFrameData.pose;
+	currFrameID = graph->getFrameID(node);
+	currFrame = graph->getFrame(currFrameID);
 	Animation::unNormaliseFrame(currFrame, currPos, currRot);
 	currPos = currFrame.pos;
 	currRot = currFrame.pose["root"];
@@ -79,7 +86,9 @@ std::vector<float> KovarMG::getNextFrame(bool* completed) {
 }
 
 glm::vec4 KovarMG::getColour() {
-	if (path.nodes.empty() || pathIdx >= path.nodes.size()) {
+	std::lock_guard<std::mutex> lock(planMutex);
+
+	if (committed.empty() || pathIdx >= committed.size()) {
 		return glm::vec4(0.25f, 0.25f, 0.25f, 1.0f);	// grey
 	}
 	else if (currFrameID.tMode) {
@@ -92,6 +101,9 @@ glm::vec4 KovarMG::getColour() {
 
 void KovarMG::setPath(const std::vector<float>& line) {
 
+	// a new path replaces the one being planned
+	cancelPath();
+
 	std::vector<glm::vec3> pathline;
 
 	// generate pathline: vector of vec3s
@@ -103,28 +115,188 @@ void KovarMG::setPath(const std::vector<float>& line) {
 	// set path radius, should be equivalent to main::PATH_RADIUS
 	float pathRadius = std::round(glm::distance(pathline[0], pathline[1]));
 
+	const int valid = validFrames(pathline, pathRadius);
+	std::string key;
 
-	std::clock_t start = std::clock();
-	searchPath(currFrameID, pathline, pathRadius);
-	std::clock_t end = std::clock();
-	double elapsed_time = double(end - start) / CLOCKS_PER_SEC;
-	std::cout << "CPU time used: " << elapsed_time << " seconds\n";
-	// Print path cost
-	std::cout << "Path Error: " << path.stack.back().cost << std::endl;
+	if (valid < 0) {
+		// the search starts from the current frame, which playback holds until the first window is committed
+		path = Path();
+		path.stack.push_back(State(graph->getNodeID(currFrameID), currPos, currRot, 0, 0, SEARCH));
+		path.nodes.push_back(path.stack.back().frameID);
+		pathIdx = 0;
+
+		// a cached plan is scored for the path & the planner finds it complete
+		key = planKey(pathline, pathRadius);
+		std::vector<Graph::NodeID> nodes;
+		if (!key.empty() && planCache->load(key, *graph, nodes) && nodes[0] == path.nodes[0]) {
+			for (int i = 1; i < nodes.size(); i++) {
+				path.stack.push_back(stepState(path.stack.back(), pathline, pathRadius, nodes[i]));
+				path.nodes.push_back(nodes[i]);
+			}
+			std::cout << "Plan Cache Hit: " << path.nodes.size() << " frames" << std::endl;
+			key.clear();
+		}
+	}
+	else {
+		// the frames already played stay as well, scored again for the new path
+		const int kept = std::max(valid, pathIdx - 1);
+		Path previous = std::move(path);
+		path = Path();
+		path.stack = std::vector<State>(previous.stack.begin(), previous.stack.begin() + valid + 1);
+		path.nodes = std::vector<Graph::NodeID>(previous.nodes.begin(), previous.nodes.begin() + kept + 1);
+		for (int i = valid + 1; i <= kept; i++) {
+			path.stack.push_back(stepState(path.stack.back(), pathline, pathRadius, previous.nodes[i]));
+		}
+		std::cout << "Frames Reused: " << path.nodes.size() << std::endl;
+	}
 
+	{
+		std::lock_guard<std::mutex> lock(planMutex);
+		committed.resize(std::min(committed.size(), path.nodes.size()));
+		committedArclens.resize(committed.size());
+		for (int i = 0; i < (int)committed.size(); i++) {
+			committedArclens[i] = path.stack[i].arclen;
+		}
+		planning = true;
+	}
+
+	plannedLine = pathline;
+	plannedRadius = pathRadius;
+
+	planner = std::thread([this, pathline = std::move(pathline), pathRadius, key]() {
+		std::clock_t start = std::clock();
+		searchPath(pathline, pathRadius);
+		std::clock_t end = std::clock();
+
+		if (cancelled) {
+			std::cout << "Path Cancelled" << std::endl;
+			return;
+		}
+
+		double elapsed_time = double(end - start) / CLOCKS_PER_SEC;
+		std::cout << "CPU time used: " << elapsed_time << " seconds\n";
+		if (searchMode == SearchMode::SEGMENT) {
+			std::cout << "Segments Expanded: " << expandedSegments << std::endl;
+		}
+		else {
+			std::cout << "States Expanded: " << expandedStates << std::endl;
+		}
+		if (transpositionTable && searchMode == SearchMode::SEGMENT) {
+			std::cout << "Transpositions: " << transpositionHits << " hits, " << transpositionMisses << " misses" << std::endl;
+		}
+		if (speculation && searchMode == SearchMode::SEGMENT) {
+			std::cout << "Windows Speculated: " << speculatedWindows << std::endl;
+		}
+		std::cout << "Windows Out of Budget: " << cutWindows << std::endl;
+		// Print path cost
+		std::cout << "Path Error: " << path.stack.back().cost << std::endl;
+
+		// only a path searched in full is cached, so a hit is the path planning it again would give
+		if (!key.empty() && cutWindows == 0 && isComplete(path, pathline)) {
+			planCache->store(key, *graph, path.nodes);
+		}
+	});
 }
 
-void KovarMG::searchPath(Graph::FrameID start_node, const std::vector<glm::vec3>& pathline, float pathRadius) {
+void KovarMG::waitForPath() {
+	if (planner.joinable()) {
+		planner.join();
+	}
+}
 
-	const auto& startFrameData = graph->getFrameVec(start_node);
+// stop the planner & wait for it, a SEGMENT search stops right away, a FRAME search at its next budget check
+void KovarMG::cancelPath() {
+	if (planner.joinable()) {
+		cancelled = true;
+		planner.join();
+	}
+	cancelled = false;
+}
+
+// Index of the last state of the path that is still planned right for the new pathline, -1 if there is no path
+// The windows are kept up to the first whose search could reach a changed point of the path or the end of either path,
+// so the frames kept are the frames planning the new path from the start would give
+int KovarMG::validFrames(const std::vector<glm::vec3>& pathline, float pathRadius) {
+	if (path.stack.empty()) {
+		return -1;
+	}
+
+	// first point of the path that changed
+	int changed = 0;
+	if (pathRadius == plannedRadius) {
+		while (changed < pathline.size() && changed < plannedLine.size() && pathline[changed] == plannedLine[changed]) {
+			changed++;
+		}
+	}
+
+	// the same path keeps everything planned
+	if (changed == pathline.size() && changed == plannedLine.size()) {
+		return path.stack.size() - 1;
+	}
+
+	// below this arclength the error only depends on unchanged points & no state completes either path
+	const float unchanged = std::min((changed - 1) * pathRadius, 0.9f * std::min(pathline.size(), plannedLine.size()));
+	const float lookahead = SEARCH * graph->getMaxFrameArclength();
+
+	// a window starts every KEEP frames & its search reaches at most SEARCH frames further
+	int valid = 0;
+	while (valid + KEEP < path.stack.size() && path.stack[valid].arclen + lookahead < unchanged) {
+		valid += KEEP;
+	}
+	return valid;
+}
+
+// Key of the path from the current frame in the plan cache, empty without a cache
+// The points are taken relative to the root & its yaw, so the plan is found wherever the path is drawn or loaded
+std::string KovarMG::planKey(const std::vector<glm::vec3>& pathline, float pathRadius) {
+	if (!planCache) {
+		return "";
+	}
 
-	State startState(start_node, currPos, currRot, 0, 0, SEARCH);
-	startState.nextFrames = sortedNextFrames(startState, pathline, pathRadius);
+	const glm::vec3 forward = currRot * glm::vec3(0.0f, 0.0f, 1.0f);
+	const float yaw = std::atan2(forward.x, forward.z);
+	const glm::vec3 origin = glm::vec3(currPos[3]);
 
-	path.stack.push_back(startState);
-	path.nodes.push_back(start_node);
+	std::vector<glm::vec3> points;
+	for (auto const& point : pathline) {
+		const glm::vec3 offset = point - origin;
+		points.push_back(glm::vec3(std::cos(yaw) * offset.x - std::sin(yaw) * offset.z, 0.0f, std::sin(yaw) * offset.x + std::cos(yaw) * offset.z));
+	}
+
+	// the settings that change the path found
+	std::string search = searchMode == SearchMode::FRAME ? "frame" : "segment";
+	search += "_" + std::to_string(SEARCH) + "_" + std::to_string(KEEP);
+
+	return PlanCache::makeKey(*graph, currFrameID, points, pathRadius, search);
+}
+
+// make the frames planned since the last commit available to playback
+void KovarMG::commit(bool done) {
+	std::lock_guard<std::mutex> lock(planMutex);
+	for (int i = committed.size(); i < (int)path.nodes.size(); i++) {
+		committed.push_back(path.nodes[i]);
+		committedArclens.push_back(path.stack[i].arclen);
+	}
+	planning = !done;
+}
+
+// Plan the path on from its last state, one window at a time
+void KovarMG::searchPath(const std::vector<glm::vec3>& pathline, float pathRadius) {
 
-	while (!isComplete(path, pathline)) {
+	expandedSegments = 0;
+	transpositionHits = 0;
+	transpositionMisses = 0;
+	expandedStates = 0;
+	cutWindows = 0;
+	speculatedWindows = 0;
+	Window* window = nullptr;
+	windows[0].next = &windows[1];
+	windows[1].next = &windows[0];
+
+	auto start = std::chrono::steady_clock::now();
+	bool firstWindow = true;
+
+	while (!isComplete(path, pathline) && !cancelled) {
 		std::cout << "Frames Constructed: " << path.nodes.size() << std::endl;
 
 		if (path.nodes.size() > MAX_PATH_LENGTH && MAX_PATH_LENGTH != -1) {
@@ -133,7 +305,15 @@ void KovarMG::searchPath(Graph::FrameID start_node, const std::vector<glm::vec3>
 		}
 
 		// branch and bound iteratively
-		const auto& nextIteration = iterateBnB(path, pathline, pathRadius);
+		const auto& nextIteration = searchMode == SearchMode::FRAME ? iterateBnB(path, pathline, pathRadius)
+			: speculation ? nextWindow(window, pathline, pathRadius)
+			: iterateSegments(path, pathline, pathRadius);
+
+		// the window of a cancelled search is cut short or empty, so the path only keeps whole windows to plan on from
+		if (cancelled || nextIteration.nodes.empty()) {
+			break;
+		}
+		cutWindows += !nextIteration.optimal;
 
 		// keep first KEEP number of nodes
 		// offset by one as we do not want to include the first node
@@ -147,208 +327,768 @@ void KovarMG::searchPath(Graph::FrameID start_node, const std::vector<glm::vec3>
 			path.stack.push_back(nextIteration.stack[i]);	
 			path.nodes.push_back(nextIteration.nodes[i]);
 		}
+
+		// playback can start as soon as the first window is searched
+		if (firstWindow) {
+			firstWindow = false;
+			std::cout << "Time to First Window: " << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " seconds" << std::endl;
+		}
+		commit(false);
 	}
+
+	// stop the speculative search of a window after the path
+	discard(windows[0]);
+	discard(windows[1]);
+
+	commit(true);
+}
+
+// Search the next window on its own thread. Its search may already run, started speculatively by the previous window
+KovarMG::Path KovarMG::nextWindow(Window*& window, const std::vector<glm::vec3>& pathline, float pathRadius) {
+	Window* next = window == nullptr ? &windows[0] : window->next;
+
+	// keep the speculative search if it started from the frames that were committed
+	const int n_start = next->start.nodes.size();
+	const bool kept = next->speculative && n_start <= path.nodes.size()
+		&& std::equal(next->start.nodes.begin(), next->start.nodes.end(), path.nodes.end() - n_start);
+
+	if (kept) {
+		speculatedWindows++;
+	}
+	else {
+		discard(*next);
+		next->start.stack.clear();
+		next->start.nodes.clear();
+		next->start.stack.push_back(path.stack.back());
+		next->start.nodes.push_back(path.nodes.back());
+		next->thread = std::thread([this, next, &pathline, pathRadius]() {
+			next->result = iterateSegments(next->start, pathline, pathRadius, next->memory, next);
+		});
+	}
+
+	// the window may now start the speculative search of the one after it
+	next->speculative = false;
+	next->thread.join();
+	window = next;
+
+	return std::move(next->result);
+}
+
+// Stop the search of a window & wait for it
+void KovarMG::discard(Window& window) {
+	if (window.thread.joinable()) {
+		window.discarded = true;
+		window.thread.join();
+	}
+	window.discarded = false;
+	window.speculative = false;
+}
+
+// (Re)start the speculative search of the window after the one searched, from the end of the KEEP frames of its best
+// path, once they have not changed for SPECULATE_AFTER expansions
+void KovarMG::speculate(const SegmentSearch& search, Incumbent& incumbent) {
+	Window* window = search.window;
+	if (window == nullptr || window->speculative) {
+		return;
+	}
+
+	const int version = incumbent.prefixVersion.load(std::memory_order_relaxed);
+	if (version == window->speculatedVersion || incumbent.expanded - incumbent.prefixSince < SPECULATE_AFTER) {
+		return;
+	}
+
+	// one search thread starts it, the others carry on
+	std::unique_lock<std::mutex> lock(window->mutex, std::try_to_lock);
+	if (!lock.owns_lock() || version == window->speculatedVersion) {
+		return;
+	}
+	window->speculatedVersion = version;
+
+	Window* next = window->next;
+	discard(*next);
+	next->start.stack.clear();
+	next->start.nodes.clear();
+	next->start.stack.push_back(window->start.stack.back());
+	next->start.nodes.push_back(window->start.nodes.back());
+	{
+		std::lock_guard<std::mutex> incumbentLock(incumbent.mutex);
+		expandSteps(incumbent.steps, KEEP, search, next->start);
+	}
+
+	// no window follows if the path ends within the frames
+	if (next->start.nodes.size() < KEEP + 1 || isComplete(next->start, search.pathline)) {
+		return;
+	}
+
+	next->speculative = true;
+	next->thread = std::thread([this, next, &pathline = search.pathline, pathRadius = search.pathRadius]() {
+		next->result = iterateSegments(next->start, pathline, pathRadius, next->memory, next);
+	});
 }
 
 KovarMG::Path KovarMG::iterateBnB(const Path& globalPath, const std::vector<glm::vec3>& pathline, float pathRadius) {
 
 	float lowerBound = std::numeric_limits<float>::max();
 
-	Path currPath;
-	Path bestPath;
-
-	currPath.stack.reserve(SEARCH + 1);
-	currPath.nodes.reserve(SEARCH + 1);
+	// the search stops at the budget once it has a path, the first being the dive along the closest frames
+	const int milliseconds = budgetMs;
+	const long long maxExpanded = budgetExpansions;
+	const auto deadline = milliseconds >= 0 ? std::chrono::steady_clock::now() + std::chrono::milliseconds(milliseconds) : std::chrono::steady_clock::time_point::max();
+	long long expanded = 0;
+	bool optimal = true;
+
+	// the stack & its next frames only grow up to the search depth, so after the first search nothing is allocated
+	frameStack.clear();
+	frameNodes.clear();
+	frameArena.clear();
+	bestNodes.clear();
+	frameStack.reserve(SEARCH + 1);
+	frameNodes.reserve(SEARCH + 1);
+	bestNodes.reserve(SEARCH + 1);
 
 	const auto& lastState = globalPath.stack.back();
 
-	// Reset depth
-	State startState(lastState.frameID, lastState.position, lastState.rotation, lastState.arclen, lastState.cost, SEARCH);
-	startState.nextFrames = lastState.nextFrames;
-
-	// Initialise current path with the previous last state
-	currPath.stack.push_back(startState);
-	currPath.nodes.push_back(globalPath.nodes.back());
+	// Initialise the stack with the previous last state, with the depth reset
+	frameStack.emplace_back(lastState.frameID, lastState.position, lastState.rotation, lastState.arclen, lastState.cost, SEARCH);
+	frameNodes.push_back(globalPath.nodes.back());
+	sortedNextFrames(frameStack.back(), pathline, pathRadius, frameArena);
 
-	while (!currPath.stack.empty()) {
+	while (!frameStack.empty()) {
 
-		State& currState = currPath.stack.back();
+		State& currState = frameStack.back();
 
 		const bool prune = currState.cost >= lowerBound;
-		const bool noNextFrames = currState.index >= currState.nextFrames.size();
+		const bool noNextFrames = currState.index >= currState.n_nextFrames;
 
-		// Break conditions
+		// Break conditions, releasing the next frames of the state
 		if (prune || noNextFrames) {
-			currPath.stack.pop_back();
-			currPath.nodes.pop_back();
+			frameArena.resize(currState.nextFrames);
+			frameStack.pop_back();
+			frameNodes.pop_back();
 			continue;
 		}
 
 		const bool firstEvaluation = currState.index == 0;
 		const bool depthReached = currState.depth == 0;
-		const bool completed = isComplete(currPath, pathline);
+		const bool completed = isComplete(glm::vec3(currState.position[3]), currState.arclen, pathline);
 
-		// End conditions
+		// End conditions, the best path is kept as the trail of its frames
 		if (firstEvaluation && (depthReached || completed)) {
 			if (currState.cost < lowerBound) {
 				lowerBound = currState.cost;
-				bestPath = Path(currPath);
+				bestNodes.assign(frameNodes.begin(), frameNodes.end());
 			}
-			currPath.stack.pop_back();
-			currPath.nodes.pop_back();
+			frameArena.resize(currState.nextFrames);
+			frameStack.pop_back();
+			frameNodes.pop_back();
 			continue;
 		}
 
-		const auto& nextFrameID = currState.nextFrames[currState.index];
-		const auto& nextFrameData = graph->getFrameVec(nextFrameID);
+		// a cancelled search stops whether or not it has reached a path, the path so far is dropped
+		const bool budgetCheck = expanded % BUDGET_CHECK == 0;
+		if (budgetCheck && cancelled) {
+			bestNodes.clear();
+			break;
+		}
+
+		const bool budgetSpent = (maxExpanded >= 0 && expanded >= maxExpanded)
+			|| (budgetCheck && std::chrono::steady_clock::now() >= deadline);
+		if (!bestNodes.empty() && budgetSpent) {
+			optimal = false;
+			break;
+		}
+		expanded++;
+
+		const auto nextFrameID = frameArena[currState.nextFrames + currState.index];
 		currState.index++;
 
-		currPath.stack.emplace_back(nextState(currState, pathline, pathRadius, nextFrameID));
-		currPath.nodes.push_back(nextFrameID);
+		frameStack.emplace_back(stepState(currState, pathline, pathRadius, nextFrameID));
+		frameNodes.push_back(nextFrameID);
+		sortedNextFrames(frameStack.back(), pathline, pathRadius, frameArena);
+	}
+	expandedStates += expanded;
+
+	// cancelled, an empty path
+	Path bestPath;
+	if (bestNodes.empty()) {
+		bestPath.optimal = false;
+		return bestPath;
+	}
+
+	// replay the trail to one state per frame
+	bestPath.stack.reserve(bestNodes.size());
+	bestPath.nodes = bestNodes;
+	bestPath.optimal = optimal;
+	bestPath.stack.emplace_back(lastState.frameID, lastState.position, lastState.rotation, lastState.arclen, lastState.cost, SEARCH);
+	for (int i = 1; i < bestNodes.size(); i++) {
+		bestPath.stack.push_back(stepState(bestPath.stack.back(), pathline, pathRadius, bestNodes[i]));
 	}
 
 	assert(bestPath.stack.size() > 1);
 	return bestPath;
 }
 
-std::vector<Graph::FrameID> KovarMG::sortedNextFrames(State currState, const std::vector<glm::vec3>& pathline, float pathRadius) {
+// Branch and bound over the segment view of the graph: a state is a node and each branch a whole edge
+// The frames of an edge are evaluated in order with the same pruning, depth & completion checks as iterateBnB,
+// so only the nodes are pushed to the stack. The best path is expanded back to one state per frame
+// A greedy dive along the closest edges gives a first bound, and branches are pruned as soon as a lower bound on their
+// cost (costBound) exceeds the best path, so only branches that may still lead to a better path are expanded
+// With more than one thread, the top of the tree is split into subtrees that the threads take in serial search order,
+// sharing the cost of the best path to prune. The result is the same as with one thread, unless the budget runs out
+// The search returns the best path so far when the budget runs out, after the greedy dive that always finds one
+KovarMG::Path KovarMG::iterateSegments(const Path& globalPath, const std::vector<glm::vec3>& pathline, float pathRadius) {
+	return iterateSegments(globalPath, pathline, pathRadius, segmentMemory, nullptr);
+}
 
-	const auto& currFrameID = currState.frameID;
-	const auto& currFrameData = graph->getFrameVec(currFrameID);
+KovarMG::Path KovarMG::iterateSegments(const Path& globalPath, const std::vector<glm::vec3>& pathline, float pathRadius, SegmentMemory& memory, Window* window) {
 
-	// Convert currFrameDate.edges from set to vector
-	std::vector<Graph::FrameID> edges;
-	edges.assign(currFrameData.edges.begin(), currFrameData.edges.end());
+	const auto& lastState = globalPath.stack.back();
 
-	// Sort the edges
-	if (edges.size() > 1) {
-		std::sort(edges.begin(), edges.end(), [&](const Graph::FrameID& f1, const Graph::FrameID& f2) {
-			const auto dArclen1 = graph->dEdgeArclength(currState.frameID, f1);
-		const auto dArclen2 = graph->dEdgeArclength(currState.frameID, f2);
-		const auto dPosition1 = graph->dEdgePosition(currState.frameID, f1);
-		const auto dPosition2 = graph->dEdgePosition(currState.frameID, f2);
-		const auto truePos1 = getTruePos(currState.arclen + dArclen1, pathRadius, pathline);
-		const auto truePos2 = getTruePos(currState.arclen + dArclen2, pathRadius, pathline);
-		const auto currPos1 = glm::vec3(currState.position[3]) + dPosition1;
-		const auto currPos2 = glm::vec3(currState.position[3]) + dPosition2;
-		const auto distance1 = glm::distance(truePos1, currPos1);
-		const auto distance2 = glm::distance(truePos2, currPos2);
+	SegmentSearch search{ pathline, pathRadius };
+	search.window = window;
+	Incumbent incumbent;
+	if (window != nullptr) {
+		window->speculatedVersion = 0;
+	}
 
-		return distance1 < distance2;
-			});
+	const int milliseconds = budgetMs;
+	if (milliseconds >= 0) {
+		search.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(milliseconds);
 	}
+	search.maxExpanded = budgetExpansions;
 
-	/* --- Generate Next Frames --- */
+	// the error to the path changes by at most how far the root & the point on the path at its arclength move
+	// the rates are rounded up, so the bound stays below the cost the search adds up in floats
+	float pathRate = 0;
+	for (int i = 0; i + 1 < pathline.size(); i++) {
+		pathRate = std::max(pathRate, glm::distance(pathline[i], pathline[i + 1]) / pathRadius);
+	}
+	search.arclenRate = std::max(graph->getMaxFrameArclength() * 1.001f, 1e-6f);
+	search.moveRate = std::max(graph->getMaxFrameDisplacement() * 1.001f, 1e-6f);
+	search.errorRate = (search.moveRate + pathRate * search.arclenRate) * 1.001f;
+
+	// a search may resume in between nodes, its first edge is the path to the next node
+	Segment start;
+	start.node = lastState.frameID;
+	start.position = lastState.position;
+	start.rotation = lastState.rotation;
+	start.arclen = lastState.arclen;
+	start.cost = lastState.cost;
+	start.depth = SEARCH;
+	start.error = pathCost(glm::vec3(start.position[3]), start.arclen, pathline, pathRadius);
+	start.estimate = costBound(start.cost, start.error, glm::vec3(start.position[3]), start.arclen, start.depth, search);
+
+	if (!graph->isNode(start.node)) {
+		graph->sampleSegment(start.node, graph->getDirectEdges(start.node)[0], -1, search.firstSamples, search.firstPos, search.firstRot);
+	}
 
-	std::vector<Graph::FrameID> nextFrames;
+	const int threads = n_threads > 0 ? n_threads : std::max(1, (int)std::thread::hardware_concurrency());
+	if (memory.workspaces.size() < threads) {
+		memory.workspaces.resize(threads);
+	}
 
-	if (edges.empty()) {						// in between nodes
-		Graph::FrameID nextFrameID;
-		nextFrameID = *currFrameData.directEdges.begin();
-		nextFrames.push_back(nextFrameID);
-		assert(!graph->isNode(currFrameID));
-		assert(currFrameData.directEdges.contains(nextFrameID));
-	}
-	else {										// nodes
-		assert(graph->isNode(currState.frameID));
-		for (auto const& nextNode : edges) {
-			Graph::FrameID nextFrameID;
-			if (currFrameData.seqEdge == nextNode) {	// sequential edge
-				nextFrameID = currFrameID;
-				nextFrameID.indexID += 1;
+	// segments of earlier windows are not transpositions of this one
+	for (auto& workspace : memory.workspaces) {
+		workspace.transpositionHits = 0;
+		workspace.transpositionMisses = 0;
+		if (transpositionTable) {
+			workspace.transpositions.resize(TRANSPOSITIONS);
+			if (++workspace.generation == 0) {
+				std::fill(workspace.transpositions.begin(), workspace.transpositions.end(), Transposition());
+				workspace.generation = 1;
 			}
-			else {										// transitional edge
-				nextFrameID.animID = currFrameID.animID;
-				nextFrameID.indexID = currFrameID.indexID + 1;
-				nextFrameID.animID2 = nextNode.animID;
-				nextFrameID.indexID2 = nextNode.indexID - graph->getWindowSize() + 1;
-				nextFrameID.tMode = true;
-				nextFrameID.alpha = 1;
+		}
+	}
+
+	// greedy dive along the closest edges to the first leaf, which the serial search would reach first as well
+	Workspace& dive = memory.workspaces[0];
+	dive.stack.assign(1, start);
+	dive.arena.clear();
+	segmentEdges(dive.stack.back(), dive, search);
+
+	Segment diveSegment;
+	while (advance(dive, search, incumbent, diveSegment)) {
+		dive.stack.push_back(diveSegment);
+	}
+
+	// split the tree level by level into subtrees, kept in serial search order
+	// a subtree is stored as the stack from the start down to its root, the edges of the root are sorted by the thread taking it
+	memory.tasks.assign(1, start);
+	memory.taskOffsets.assign({ 0, 1 });
+	while (threads > 1 && memory.taskOffsets.size() - 1 < threads * TASKS_PER_THREAD) {
+		memory.splitTasks.clear();
+		memory.splitOffsets.assign(1, 0);
+
+		Workspace& split = memory.workspaces[0];
+		for (int t = 0; t + 1 < memory.taskOffsets.size(); t++) {
+			split.stack.assign(memory.tasks.begin() + memory.taskOffsets[t], memory.tasks.begin() + memory.taskOffsets[t + 1]);
+			split.arena.clear();
+			segmentEdges(split.stack.back(), split, search);
+
+			Segment next;
+			while (split.stack.back().index < split.stack.back().n_edges) {
+				if (advance(split, search, incumbent, next)) {
+					memory.splitTasks.insert(memory.splitTasks.end(), split.stack.begin(), split.stack.end());
+					memory.splitTasks.push_back(next);
+					memory.splitOffsets.push_back(memory.splitTasks.size());
+				}
 			}
-			nextFrames.push_back(nextFrameID);
-			assert(currFrameData.directEdges.contains(nextFrameID));
+		}
+
+		memory.tasks.swap(memory.splitTasks);
+		memory.taskOffsets.swap(memory.splitOffsets);
+		if (memory.taskOffsets.size() == 1) {
+			break;
 		}
 	}
-	assert(!nextFrames.empty());
-	assert(nextFrames.size() == currFrameData.directEdges.size());
 
-	return nextFrames;
+	// the threads take the next subtree, so the most promising ones are searched first
+	const int n_tasks = memory.taskOffsets.size() - 1;
+	std::atomic<int> nextTask = 0;
+	auto work = [&](Workspace& workspace) {
+		for (int t = nextTask++; t < n_tasks && !incumbent.stopped; t = nextTask++) {
+			workspace.stack.assign(memory.tasks.begin() + memory.taskOffsets[t], memory.tasks.begin() + memory.taskOffsets[t + 1]);
+			workspace.arena.clear();
+			segmentEdges(workspace.stack.back(), workspace, search);
+			searchSegments(workspace, search, incumbent);
+		}
+	};
+
+	if (threads > 1 && n_tasks > 1) {
+		std::vector<std::thread> workers;
+		for (int i = 0; i < std::min(threads, n_tasks); i++) {
+			workers.push_back(std::thread(work, std::ref(memory.workspaces[i])));
+		}
+		for (auto& worker : workers) {
+			worker.join();
+		}
+	}
+	else {
+		work(memory.workspaces[0]);
+	}
+
+	expandedSegments += incumbent.expanded;
+	for (auto const& workspace : memory.workspaces) {
+		transpositionHits += workspace.transpositionHits;
+		transpositionMisses += workspace.transpositionMisses;
+	}
+
+	// expand the best steps to one state per frame
+	Path bestPath;
+	bestPath.optimal = !incumbent.stopped;
+
+	bestPath.stack.emplace_back(lastState.frameID, lastState.position, lastState.rotation, lastState.arclen, lastState.cost, SEARCH);
+	bestPath.nodes.push_back(globalPath.nodes.back());
+
+	expandSteps(incumbent.steps, std::numeric_limits<int>::max(), search, bestPath);
+
+	assert(bestPath.stack.size() > 1);
+	return bestPath;
 }
 
-float KovarMG::pathCost(const State& currState, const std::vector<glm::vec3>& pathline, float pathRadius) {
-	glm::vec3 currPos = glm::vec3(currState.position[3][0], 0.0f, currState.position[3][2]);
-	glm::vec3 truePos = getTruePos(currState.arclen, pathRadius, pathline);
+// Append the states of the first frames of the steps to the path, following on from its last state
+void KovarMG::expandSteps(const std::vector<Step>& steps, int frames, const SegmentSearch& search, Path& localPath) {
+	Graph::NodeID node = localPath.stack.back().frameID;
+	for (auto const& step : steps) {
+		const auto samples = step.edge == -1 ? std::span<const Graph::SegmentSample>(search.firstSamples) : graph->getEdgeSamples(node, step.edge);
 
-	float distance = glm::distance(currPos, truePos);
+		for (int i = 0; i < step.frames && frames > 0; i++, frames--) {
+			localPath.stack.push_back(stepState(localPath.stack.back(), search.pathline, search.pathRadius, samples[i].frame));
+			localPath.nodes.push_back(samples[i].frame);
+		}
+		node = samples.back().frame;
+	}
+}
 
-	if (std::isnan(distance)) {
-		throw new std::exception("Distance is nan!");
+// Check if two paths of steps from the same node share the first KEEP frames
+bool KovarMG::samePrefix(const std::vector<Step>& a, const std::vector<Step>& b) {
+	int frames = 0;
+	for (int j = 0; j < a.size() && j < b.size() && frames < KEEP; j++) {
+		if (a[j].edge != b[j].edge || std::min(a[j].frames, KEEP - frames) != std::min(b[j].frames, KEEP - frames)) {
+			return false;
+		}
+		frames += a[j].frames;
 	}
+	return frames >= KEEP || a.size() == b.size();
+}
+
+// Depth first search of the subtree below the last segment of the stack of the workspace
+void KovarMG::searchSegments(Workspace& workspace, const SegmentSearch& search, Incumbent& incumbent) {
 
-	return distance;
+	auto& stack = workspace.stack;
+	const size_t root = stack.size() - 1;
+
+	Segment nextSegment;
+	int steps = 0;
+	while (stack.size() > root) {
+
+		if (++steps % BUDGET_CHECK == 0) {
+			if (outOfBudget(search, incumbent)) {
+				return;
+			}
+			speculate(search, incumbent);
+		}
+
+		const Segment& currSegment = stack.back();
+
+		// Break conditions, equal costs are left to prunes on the frames of the edges
+		// the edges of the segment are the last in the arena & are released with it
+		if (currSegment.estimate > incumbent.bound.load(std::memory_order_relaxed) || currSegment.index >= currSegment.n_edges) {
+			workspace.arena.resize(currSegment.edges);
+			stack.pop_back();
+			continue;
+		}
+
+		if (advance(workspace, search, incumbent, nextSegment)) {
+			if (transpositionTable && transposed(workspace, nextSegment)) {
+				workspace.arena.resize(nextSegment.edges);
+				continue;
+			}
+			stack.push_back(nextSegment);
+		}
+	}
 }
 
-bool KovarMG::isComplete(const Path& localPath, const std::vector<glm::vec3>& pathline) {
+// Look the segment up in the transposition table of the thread. Returns true if it is dominated by a segment searched
+// before: with the same node & quantised root, its cost is no lower & its remaining depth no smaller, so its subtree
+// holds no better path. Otherwise the segment replaces the entry
+bool KovarMG::transposed(Workspace& workspace, const Segment& segment) {
+	const glm::vec3 forward = segment.rotation * glm::vec3(0.0f, 0.0f, 1.0f);
+
+	Transposition key;
+	key.node = segment.node;
+	key.x = std::floor(segment.position[3][0] / POSITION_QUANTUM);
+	key.z = std::floor(segment.position[3][2] / POSITION_QUANTUM);
+	key.yaw = std::floor(std::atan2(forward.x, forward.z) / YAW_QUANTUM);
+	key.arclen = std::floor(segment.arclen / ARCLEN_QUANTUM);
+	key.cost = segment.cost;
+	key.depth = segment.depth;
+	key.generation = workspace.generation;
+
+	size_t hash = std::hash<int>()(key.node);
+	for (const int value : { key.x, key.z, key.yaw, key.arclen }) {
+		hash ^= std::hash<int>()(value) + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+	}
+	Transposition& entry = workspace.transpositions[hash & (TRANSPOSITIONS - 1)];
 
-	glm::vec3 lastPos = pathline.back();
-	glm::vec3 currPos = localPath.stack.back().position[3];
-	currPos[1] = 0.0f;	// cast to floor
+	const bool same = entry.generation == key.generation && entry.node == key.node && entry.x == key.x && entry.z == key.z
+		&& entry.yaw == key.yaw && entry.arclen == key.arclen;
+	if (same && entry.cost <= key.cost && entry.depth <= key.depth) {
+		workspace.transpositionHits++;
+		return true;
+	}
 
-	bool isClose = glm::distance(currPos, lastPos) < MARGIN;
-	bool isGoodLength = localPath.stack.back().arclen > pathline.size() * 0.9;
+	workspace.transpositionMisses++;
+	entry = key;
+	return false;
+}
 
-	return isClose && isGoodLength;
+// Sort the edges of a segment into the arena, a search resuming in between nodes only has the path to the next node
+void KovarMG::segmentEdges(Segment& segment, Workspace& workspace, const SegmentSearch& search) {
+	segment.edges = workspace.arena.size();
+	if (graph->isNode(segment.node)) {
+		sortedEdges(segment.node, segment.position, segment.arclen, search.pathline, search.pathRadius, workspace.arena);
+	}
+	else {
+		workspace.arena.push_back(std::make_pair(0.0f, -1));
+	}
+	segment.n_edges = workspace.arena.size() - segment.edges;
 }
 
-glm::vec3 KovarMG::getTruePos(float arclen, float pathRadius, const std::vector<glm::vec3>& pathline) {
+// Evaluate the frames of the next edge of the last segment of the stack
+// Returns true with the segment at the end of the edge, its edges sorted into the arena, if the search continues from there
+bool KovarMG::advance(Workspace& workspace, const SegmentSearch& search, Incumbent& incumbent, Segment& next) {
+
+	auto& stack = workspace.stack;
+	Segment& currSegment = stack.back();
+
+	const int edge = workspace.arena[currSegment.edges + currSegment.index].second;
+	currSegment.index++;
+	incumbent.expanded.fetch_add(1, std::memory_order_relaxed);
+
+	const auto samples = edge == -1 ? std::span<const Graph::SegmentSample>(search.firstSamples) : graph->getEdgeSamples(currSegment.node, edge);
+
+	// only the yaw of the start rotation is applied to the samples
+	glm::quat yaw = currSegment.rotation;
+	yaw.x = 0;
+	yaw.z = 0;
+	yaw = glm::normalize(yaw);
+
+	// evaluate the frames of the edge
+	glm::vec3 position = glm::vec3(currSegment.position[3]);
+	float arclen = currSegment.arclen;
+	float cost = currSegment.cost;
+	float error = currSegment.error;
+	float estimate = currSegment.estimate;
+
+	for (int i = 0; i < samples.size(); i++) {
+		cost += std::pow(error, 2);	// sum of squared error
+		position = glm::vec3(currSegment.position * glm::vec4(yaw * samples[i].offset, 1.0f));
+		arclen = currSegment.arclen + samples[i].arclen;
+		const int depth = currSegment.depth - i - 1;
+
+		if (prunes(cost, stack, incumbent)) {
+			return false;
+		}
 
-	// get index in float
-	float indexf = arclen / pathRadius;
+		// End conditions
+		if (depth == 0 || isComplete(position, arclen, search.pathline)) {
+			offer(cost, stack, edge, i + 1, search, incumbent);
+			return false;
+		}
 
-	// get real index and its remainder
-	int index = floor(indexf);
-	float remainder = indexf - index;
+		// no path along the rest of the edge can beat the best path
+		error = pathCost(position, arclen, search.pathline, search.pathRadius);
+		estimate = costBound(cost, error, position, arclen, depth, search);
+		if (estimate > incumbent.bound.load(std::memory_order_relaxed)) {
+			return false;
+		}
+	}
 
-	if (index + 1 < pathline.size()) {
-		// get the two start and end points that indexf lies in
-		glm::vec3 S = pathline[index];
-		glm::vec3 E = pathline[index + 1];
+	// continue from the node at the end of the edge
+	next.node = samples.back().frame;
+	next.position = edge == -1 ? search.firstPos : graph->getEdgeMotions(currSegment.node)[edge].rootPos;
+	next.rotation = edge == -1 ? search.firstRot : graph->getEdgeMotions(currSegment.node)[edge].rootRot;
+	Animation::unNormaliseTransform(next.position, next.rotation, currSegment.position, currSegment.rotation);
+	next.arclen = arclen;
+	next.cost = cost;
+	next.error = error;
+	next.estimate = estimate;
+	next.depth = currSegment.depth - samples.size();
+	next.edge = edge;
+	next.index = 0;
+	segmentEdges(next, workspace, search);
+
+	return true;
+}
 
-		// interpolate between them
-		glm::vec3 P = S * (1 - remainder) + E * (remainder);
+// Admissible lower bound on the cost of every path continuing from a frame at the given error from the path
+// In k frames the error shrinks by at most k * errorRate, and a path only ends once it is deep enough or could be complete,
+// so the bound adds up max(0, error - k * errorRate)^2 over the frames it takes at least to end
+float KovarMG::costBound(float cost, float error, const glm::vec3& position, float arclen, int depth, const SegmentSearch& search) {
+
+	// frames until isComplete can hold
+	glm::vec3 currPos = position;
+	currPos[1] = 0.0f;
+	const double toArclen = (search.pathline.size() * 0.9 - arclen) / search.arclenRate;
+	const double toEnd = (glm::distance(currPos, search.pathline.back()) - MARGIN) / search.moveRate;
+	const double frames = std::max(toArclen, toEnd);
+	const int m = frames >= depth ? depth : std::max(1, (int)std::floor(frames) + 1);
+
+	// the first error is added as is, the following ones in closed form while they are positive
+	const float next = cost + std::pow(error, 2);
+	const double e = error;
+	const double r = search.errorRate;
+	const double n = e / r >= m - 1 ? m - 1 : std::floor(e / r);
+	const double rest = n * e * e - e * r * n * (n + 1) + r * r * n * (n + 1) * (2 * n + 1) / 6.0;
+
+	// leave a margin for the rounding of the sums of the search
+	const double margin = (next + rest) * m * 1.2e-7;
+	return next + std::max(0.0, rest * 0.999 - margin);
+}
 
-		return P;
+// Check the budget of the search, the first thread to find it spent stops all
+bool KovarMG::outOfBudget(const SegmentSearch& search, Incumbent& incumbent) {
+	if (incumbent.stopped.load(std::memory_order_relaxed)) {
+		return true;
 	}
-	else {
-		return pathline.back();
+
+	// the path was cancelled or the speculative search discarded
+	if (cancelled || (search.window != nullptr && search.window->discarded)) {
+		incumbent.stopped = true;
+		return true;
+	}
+
+	const long long expanded = incumbent.expanded.load(std::memory_order_relaxed);
+	if ((search.maxExpanded >= 0 && expanded >= search.maxExpanded) || std::chrono::steady_clock::now() >= search.deadline) {
+		incumbent.stopped = true;
+		return true;
 	}
+	return false;
 }
 
-KovarMG::State KovarMG::nextState(const State& currState, const std::vector<glm::vec3>& pathline, float pathRadius, Graph::FrameID nextFrame) {
+// Check if the best path comes first in serial search order, the order of the stack is the index into the sorted edges
+// at every segment, the last one being the edge under evaluation
+bool KovarMG::precedes(const std::vector<int>& order, const std::vector<Segment>& stack) {
+	for (int j = 0; j < order.size() && j < stack.size(); j++) {
+		if (order[j] != stack[j].index - 1) {
+			return order[j] < stack[j].index - 1;
+		}
+	}
+	return order.size() < stack.size();
+}
 
-	const auto& nexFrameData = graph->getFrameVec(nextFrame);
+// Check if the paths along the edge being evaluated cannot beat the best path
+// the costs only grow, so they cannot if the cost is higher or if it is equal and the best path comes first in serial order
+bool KovarMG::prunes(float cost, const std::vector<Segment>& stack, Incumbent& incumbent) {
+	const float bound = incumbent.bound.load(std::memory_order_relaxed);
+	if (cost != bound) {
+		return cost > bound;
+	}
 
-	glm::mat4 position = nexFrameData.pose.pos;
-	glm::quat rotation = nexFrameData.pose.pose.at("root");
+	std::lock_guard<std::mutex> lock(incumbent.mutex);
+	if (cost != incumbent.cost) {
+		return cost > incumbent.cost;
+	}
+	return precedes(incumbent.order, stack);
+}
+
+// Offer the path ending after the given number of frames of the edge being evaluated as the best path
+void KovarMG::offer(float cost, const std::vector<Segment>& stack, int edge, int frames, const SegmentSearch& search, Incumbent& incumbent) {
+	std::lock_guard<std::mutex> lock(incumbent.mutex);
+	if (cost > incumbent.cost || (cost == incumbent.cost && precedes(incumbent.order, stack))) {
+		return;
+	}
+
+	incumbent.order.clear();
+	incumbent.previous.swap(incumbent.steps);
+	incumbent.steps.clear();
+	for (int j = 0; j < stack.size(); j++) {
+		incumbent.order.push_back(stack[j].index - 1);
+	}
+	for (int j = 1; j < stack.size(); j++) {
+		const int edgeFrames = stack[j].edge == -1 ? search.firstSamples.size() : graph->getEdgeSamples(stack[j - 1].node, stack[j].edge).size();
+		incumbent.steps.push_back({ stack[j].edge, edgeFrames });
+	}
+	incumbent.steps.push_back({ edge, frames });
+
+	if (search.window != nullptr && !samePrefix(incumbent.previous, incumbent.steps)) {
+		incumbent.prefixVersion++;
+		incumbent.prefixSince = incumbent.expanded.load(std::memory_order_relaxed);
+	}
+
+	incumbent.cost = cost;
+	incumbent.bound.store(cost, std::memory_order_relaxed);
+}
+
+// Append the next frames of a state to the arena, sorted by the distance to the path after their edge
+void KovarMG::sortedNextFrames(State& currState, const std::vector<glm::vec3>& pathline, float pathRadius, std::vector<Graph::NodeID>& arena) {
+
+	const auto& currNode = currState.frameID;
+	const auto edges = graph->getEdges(currNode);
+	const auto successors = graph->getEdgeSuccessors(currNode);
+
+	/* --- Generate Next Frames --- */
+
+	currState.nextFrames = arena.size();
+
+	if (edges.empty()) {						// in between nodes
+		arena.push_back(graph->getDirectEdges(currNode)[0]);
+		assert(!graph->isNode(currNode));
+	}
+	else {										// nodes, the successor is the sequential or the first transition frame
+		assert(graph->isNode(currNode));
+		frameOrder.clear();
+		sortedEdges(currNode, currState.position, currState.arclen, pathline, pathRadius, frameOrder);
+		for (auto const& [distance, e] : frameOrder) {
+			arena.push_back(successors[e]);
+		}
+	}
+
+	currState.n_nextFrames = arena.size() - currState.nextFrames;
+	assert(currState.n_nextFrames > 0);
+	assert(currState.n_nextFrames == graph->getDirectEdges(currNode).size());
+}
+
+// Append the edges of a node to order, sorted by the distance to the path after the edge
+void KovarMG::sortedEdges(Graph::NodeID node, const glm::mat4& position, float arclen, const std::vector<glm::vec3>& pathline, float pathRadius, std::vector<std::pair<float, int>>& order) {
+
+	const auto motions = graph->getEdgeMotions(node);
+	const size_t first = order.size();
+
+	// Distance to the path after each edge, computed once per edge instead of in every comparison
+	for (int e = 0; e < motions.size(); e++) {
+		const auto truePos = getTruePos(arclen + motions[e].dArclen, pathRadius, pathline);
+		const auto currPos = glm::vec3(position[3]) + motions[e].dPosition;
+		order.push_back(std::make_pair(glm::distance(truePos, currPos), e));
+	}
+
+	if (motions.size() > 1) {
+		std::sort(order.begin() + first, order.end(), [](const auto& e1, const auto& e2) {
+			return e1.first < e2.first;
+			});
+	}
+}
+
+float KovarMG::pathCost(const State& currState, const std::vector<glm::vec3>& pathline, float pathRadius) {
+	return pathCost(glm::vec3(currState.position[3]), currState.arclen, pathline, pathRadius);
+}
+
+bool KovarMG::isComplete(const Path& localPath, const std::vector<glm::vec3>& pathline) {
+	return isComplete(glm::vec3(localPath.stack.back().position[3]), localPath.stack.back().arclen, pathline);
+}
+
+// Move the state by one frame
+KovarMG::State KovarMG::stepState(const State& currState, const std::vector<glm::vec3>& pathline, float pathRadius, Graph::NodeID nextFrame) {
+
+	glm::mat4 position = graph->getRootPos(nextFrame);
+	glm::quat rotation = graph->getRootRot(nextFrame);
 
 	Animation::unNormaliseTransform(position, rotation, currState.position, currState.rotation);
-	float arclen = currState.arclen + graph->dFrameArclength(currState.frameID, nextFrame);
+	float arclen = currState.arclen + graph->getFrameArclength(currState.frameID, nextFrame);
 	float cost = currState.cost + std::pow(pathCost(currState, pathline, pathRadius), 2);	// sum of squared error
 	int depth = currState.depth - 1;
 
-	State nextState(nextFrame, position, rotation, arclen, cost, depth);
-	nextState.nextFrames = sortedNextFrames(nextState, pathline, pathRadius);
+	return State(nextFrame, position, rotation, arclen, cost, depth);
+}
+
+void KovarMG::setSearchMode(SearchMode mode) {
+	searchMode = mode;
+}
+
+void KovarMG::setThreads(int _n_threads) {
+	n_threads = _n_threads;
+}
+
+void KovarMG::setBudget(int milliseconds, long long expansions) {
+	budgetMs = milliseconds;
+	budgetExpansions = expansions;
+}
+
+void KovarMG::setSpeculation(bool _speculation) {
+	speculation = _speculation;
+}
+
+void KovarMG::setTranspositions(bool _transpositionTable) {
+	transpositionTable = _transpositionTable;
+}
 
-	return nextState;
+void KovarMG::setPlanCache(const std::string cachedir) {
+	if (cachedir.empty()) {
+		planCache.reset();
+	}
+	else {
+		planCache.emplace(cachedir);
+	}
+}
+
+KovarMG::~KovarMG() {
+	cancelPath();
 }
 
 void KovarMG::reset() {
+	cancelPath();
 	currFrameID = graph->getFirstNode();
-	currFrame = Animation::Frame(graph->getFrameVec(currFrameID).pose);
+	currFrame = graph->getFrame(currFrameID);
 	currFrame.pos[3][1] = graph->getRealPos(currFrameID)[3][1];
 	currPos = currFrame.pos;
 	currRot = currFrame.pose["root"];
 	path = Path();
 	pathnodes = std::vector<Graph::FrameID>();
 	pathIdx = 0;
+	plannedLine.clear();
+
+	std::lock_guard<std::mutex> lock(planMutex);
+	committed.clear();
+	committedArclens.clear();
+	planning = false;
+}
+
+int KovarMG::getPlayedFrames() {
+	return pathIdx;
+}
+
+float KovarMG::getPlayedArclength() {
+	std::lock_guard<std::mutex> lock(planMutex);
+	return pathIdx > 0 && pathIdx <= (int)committedArclens.size() ? committedArclens[pathIdx - 1] : 0.0f;
 }
\ No newline at end of file
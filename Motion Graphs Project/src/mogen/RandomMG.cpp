@@ -2,15 +2,12 @@
 
 std::vector<float> RandomMG::getNextFrame(bool* completed) {
 
-	// select random edge
-	const auto& directEdges = graph->getFrameVec(currFrameID).directEdges;
-	auto directEdgesIt = directEdges.begin();
-	for (int i = 1; i < rand() % graph->getFrameVec(currFrameID).directEdges.size(); i++) {
-		directEdgesIt++;
-	}
+	// select random edge, from the compiled graph which also holds the frames of lazy transitions
+	const auto directEdges = graph->getDirectEdges(graph->getNodeID(currFrameID));
+	const int index = std::max(0, rand() % (int)directEdges.size() - 1);
 
-	currFrameID = *directEdgesIt;
-	currFrame = graph->getFrameVec(currFrameID).pose;
+	currFrameID = graph->getFrameID(directEdges[index]);
+	currFrame = graph->getFrame(currFrameID);
 	Animation::unNormaliseFrame(currFrame, currPos, currRot);
 	currPos = currFrame.pos;
 	currRot = currFrame.pose["root"];